@@ -0,0 +1,28 @@
+#pragma once
+
+// Counting replacements of the global operator new and delete, for the tests
+// and tools that report allocations. Include it from exactly one translation
+// unit of a program.
+//
+// The counters are per thread, so threads that parse in parallel do not
+// contend on them; a single-threaded program reads them directly.
+
+#include <cstdlib>
+#include <new>
+
+inline thread_local size_t allocationCount = 0;
+inline thread_local size_t allocationBytes = 0;
+
+void* operator new(size_t size) {
+    allocationCount++;
+    allocationBytes += size;
+    if (auto pointer = malloc(size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+// Not inlined, so the compiler does not see free() called on the result of
+// a new expression and warn about a mismatch; the memory came from malloc().
+__attribute__((noinline)) void operator delete(void* pointer) noexcept { free(pointer); }
+__attribute__((noinline)) void operator delete(void* pointer, size_t) noexcept { free(pointer); }
@@ -0,0 +1,287 @@
+#pragma once
+
+// Differences between two parse results.
+//
+// diffResults() compares an old and a new ResultMap and returns an edit
+// script: the nodes removed from the old tree, the nodes inserted into the
+// new one, and the leaves whose value changed. Results parsed with
+// subtreeHashes on carry a hash of every subtree, so equal subtrees are
+// recognised in O(1) and never walked; only the paths down to actual edits
+// are visited. Subtrees are taken to be equal when their hashes are,
+// ignoring 64-bit collisions. Without hashes the trees are compared node by
+// node, which gives correct but not always minimal scripts.
+//
+// Children are aligned with Myers' O(ND) algorithm on their hashes, so the
+// script has the fewest insertions and removals per list. Where nodes are
+// removed and inserted at the same place, those that look like the same
+// node - same name and, for declarations, the same "name" child - are
+// compared recursively instead, so renaming one field of a struct is one
+// changed leaf rather than a replaced struct.
+
+#include "parser.h"
+
+#include <algorithm>
+
+enum class EditKind {
+    Inserted,
+    Removed,
+    Changed
+};
+
+struct AstEdit {
+    EditKind kind;
+    // Enclosing nodes, outermost first, each with its "name" child when it
+    // has one: "ast/struct Line/function toString". "item" wrappers are
+    // left out.
+    string path;
+    // Position among its siblings, in the old tree for removed and changed
+    // nodes and in the new tree for inserted ones.
+    size_t index;
+    // Null for inserted and removed nodes respectively. They point into the
+    // results passed to diffResults().
+    const ResultItem* before;
+    const ResultItem* after;
+};
+
+namespace ast_diff {
+
+// Whether two subtrees are known to be equal from their hashes; a hash of
+// 0 was not computed.
+bool sameHash(size_t a, size_t b) {
+    return a != 0 && a == b;
+}
+
+const ResultMap* childrenOf(const ResultItem& item) {
+    return item.value.index() == 1 ? &std::get<1>(item.value) : nullptr;
+}
+
+// The value of the leaf child called "name", which declarations have.
+const string* nameOf(const ResultItem& item) {
+    if (auto children = childrenOf(item)) {
+        for (auto& child : *children) {
+            if (child.name == "name" && child.value.index() == 0) {
+                return &std::get<0>(child.value);
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Whether an old and a new node are versions of the same one.
+bool sameIdentity(const ResultItem& a, const ResultItem& b) {
+    auto& x = unwrapped(a);
+    auto& y = unwrapped(b);
+    if (x.name != y.name) {
+        return false;
+    }
+    auto nameX = nameOf(x);
+    auto nameY = nameOf(y);
+    return nameX == nameY || (nameX && nameY && *nameX == *nameY);
+}
+
+string pathOf(const string& parent, const ResultItem& item) {
+    if (item.name == "item") {
+        return parent;
+    }
+    auto path = parent.empty() ? item.name : parent + "/" + item.name;
+    if (auto name = nameOf(item)) {
+        path += " " + *name;
+    }
+    return path;
+}
+
+enum class Step {
+    Keep,
+    Remove,
+    Insert
+};
+
+// Lists that differ in more places than this are not aligned; all of the
+// old list is removed and all of the new one inserted. Alignment costs
+// O(D^2) memory for D differences.
+const int maxAlignedEdits = 4096;
+
+// The shortest alignment of two lists of subtree hashes, as steps in
+// document order.
+vector<Step> align(const vector<size_t>& a, const vector<size_t>& b) {
+    int n = a.size(), m = b.size();
+    int offset = n + m + 1;
+    vector<int> v(2 * offset + 1, 0);
+    // The entries of v for k in [-d, d] before step d.
+    vector<vector<int>> trace;
+
+    int distance = 0;
+    for (;; distance++) {
+        if (distance > maxAlignedEdits) {
+            vector<Step> steps(n, Step::Remove);
+            steps.insert(steps.end(), m, Step::Insert);
+            return steps;
+        }
+        trace.emplace_back(v.begin() + offset - distance, v.begin() + offset + distance + 1);
+        bool done = false;
+        for (int k = -distance; k <= distance && !done; k += 2) {
+            int x = (k == -distance || (k != distance && v[offset + k - 1] < v[offset + k + 1]))
+                ? v[offset + k + 1]
+                : v[offset + k - 1] + 1;
+            int y = x - k;
+            while (x < n && y < m && sameHash(a[x], b[y])) {
+                x++;
+                y++;
+            }
+            v[offset + k] = x;
+            done = x >= n && y >= m;
+        }
+        if (done) {
+            break;
+        }
+    }
+
+    vector<Step> steps;
+    int x = n, y = m;
+    for (int d = distance; d > 0; d--) {
+        auto previous = [&](int k) { return trace[d][k + d]; };
+        int k = x - y;
+        int previousK = (k == -d || (k != d && previous(k - 1) < previous(k + 1))) ? k + 1 : k - 1;
+        int previousX = previous(previousK);
+        int previousY = previousX - previousK;
+        for (; x > previousX && y > previousY; x--, y--) {
+            steps.push_back(Step::Keep);
+        }
+        steps.push_back(previousK == k + 1 ? Step::Insert : Step::Remove);
+        x = previousX;
+        y = previousY;
+    }
+    for (; x > 0; x--) {
+        steps.push_back(Step::Keep);
+    }
+    reverse(steps.begin(), steps.end());
+    return steps;
+}
+
+class Differ {
+public:
+    vector<AstEdit> edits;
+    // Nodes compared, and how many of them were equal by hash.
+    size_t compared = 0;
+    size_t skipped = 0;
+
+    void compare(const ResultItem& a, const ResultItem& b, const string& path, size_t index) {
+        compared++;
+        if (sameHash(a.hash, b.hash)) {
+            skipped++;
+            return;
+        }
+        auto childrenA = childrenOf(a);
+        auto childrenB = childrenOf(b);
+        if (a.name == b.name && !childrenA && !childrenB && std::get<0>(a.value) == std::get<0>(b.value)) {
+            return;
+        }
+        if (a.name != b.name || !childrenA || !childrenB) {
+            edits.push_back(AstEdit{EditKind::Changed, path, index, &a, &b});
+            return;
+        }
+        children(*childrenA, *childrenB, pathOf(path, a));
+    }
+
+    void children(const ResultMap& a, const ResultMap& b, const string& path) {
+        // Equal ends are common and need no alignment.
+        size_t start = 0;
+        while (start < a.size() && start < b.size() && sameHash(a[start].hash, b[start].hash)) {
+            start++;
+        }
+        size_t endA = a.size(), endB = b.size();
+        while (endA > start && endB > start && sameHash(a[endA - 1].hash, b[endB - 1].hash)) {
+            endA--;
+            endB--;
+        }
+        compared += start + (a.size() - endA);
+        skipped += start + (a.size() - endA);
+
+        vector<size_t> middleA, middleB;
+        for (auto i = start; i < endA; i++) {
+            middleA.push_back(a[i].hash);
+        }
+        for (auto i = start; i < endB; i++) {
+            middleB.push_back(b[i].hash);
+        }
+        size_t x = start, y = start;
+        vector<size_t> removed, inserted;
+        for (auto step : align(middleA, middleB)) {
+            if (step == Step::Keep) {
+                replaced(a, b, removed, inserted, path);
+                compared++;
+                skipped++;
+                x++;
+                y++;
+            } else if (step == Step::Remove) {
+                removed.push_back(x++);
+            } else {
+                inserted.push_back(y++);
+            }
+        }
+        replaced(a, b, removed, inserted, path);
+    }
+
+private:
+    // Nodes `removed` from `a` where `inserted` were put in `b`: pairs that
+    // are the same node are compared, the rest are edits of their own.
+    void replaced(const ResultMap& a, const ResultMap& b, vector<size_t>& removed, vector<size_t>& inserted,
+                  const string& path) {
+        vector<bool> paired(inserted.size(), false);
+        size_t next = 0;
+        for (auto i : removed) {
+            size_t match = next;
+            while (match < inserted.size() && !sameIdentity(a[i], b[inserted[match]])) {
+                match++;
+            }
+            if (match < inserted.size()) {
+                compare(a[i], b[inserted[match]], path, i);
+                paired[match] = true;
+                next = match + 1;
+            } else {
+                edits.push_back(AstEdit{EditKind::Removed, path, i, &a[i], nullptr});
+            }
+        }
+        for (size_t j = 0; j < inserted.size(); j++) {
+            if (!paired[j]) {
+                edits.push_back(AstEdit{EditKind::Inserted, path, inserted[j], nullptr, &b[inserted[j]]});
+            }
+        }
+        removed.clear();
+        inserted.clear();
+    }
+};
+
+}
+
+// The edits that turn the results of one parse into those of another.
+vector<AstEdit> diffResults(const ResultMap& before, const ResultMap& after) {
+    ast_diff::Differ differ;
+    differ.children(before, after, "");
+    return std::move(differ.edits);
+}
+
+// One line per edit: "+" inserted, "-" removed, "~" changed, then the path
+// and a summary of the node.
+void writeEdits(ostream& out, const vector<AstEdit>& edits) {
+    auto summary = [](const ResultItem& item) {
+        auto& node = unwrapped(item);
+        if (node.value.index() == 0) {
+            return node.name + ": \"" + std::get<0>(node.value) + "\"";
+        }
+        auto name = ast_diff::nameOf(node);
+        return name ? node.name + " " + *name : node.name;
+    };
+
+    for (auto& edit : edits) {
+        auto path = edit.path.empty() ? "" : edit.path + " ";
+        if (edit.kind == EditKind::Inserted) {
+            out << "+ " << path << "[" << edit.index << "] " << summary(*edit.after) << "\n";
+        } else if (edit.kind == EditKind::Removed) {
+            out << "- " << path << "[" << edit.index << "] " << summary(*edit.before) << "\n";
+        } else {
+            out << "~ " << path << "[" << edit.index << "] " << summary(*edit.before)
+                << " -> " << summary(*edit.after) << "\n";
+        }
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+// Machine-readable output of parse results.
+//
+// writeJson() writes a result tree as nested objects: leaves as
+// {"name": ..., "value": ...} and nodes as {"name": ..., "children": [...]}.
+// writeBinaryTree() writes it in the varint encoding of the replay bundles:
+// the number of items, then for each its name, a kind byte (0 leaf, 1 node)
+// and either the value or its children in the same form.
+
+#include "parser.h"
+#include "replay.h"
+
+void writeJsonString(ostream& out, string_view text) {
+    out << '"';
+    for (unsigned char ch : text) {
+        switch (ch) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (ch < 0x20) {
+                    const char digits[] = "0123456789abcdef";
+                    out << "\\u00" << digits[ch >> 4] << digits[ch & 15];
+                } else {
+                    out << ch;
+                }
+        }
+    }
+    out << '"';
+}
+
+void writeJson(ostream& out, const ResultMap& items) {
+    out << '[';
+    for (size_t i = 0; i < items.size(); i++) {
+        auto& item = items[i];
+        out << (i == 0 ? "" : ",") << "{\"name\":";
+        writeJsonString(out, item.name);
+        if (item.value.index() == 0) {
+            out << ",\"value\":";
+            writeJsonString(out, std::get<0>(item.value));
+        } else {
+            out << ",\"children\":";
+            writeJson(out, std::get<1>(item.value));
+        }
+        out << '}';
+    }
+    out << ']';
+}
+
+void writeBinaryTree(ostream& out, const ResultMap& items) {
+    using namespace replay_format;
+
+    writeVarint(out, items.size());
+    for (auto& item : items) {
+        writeString(out, item.name);
+        out.put(char(item.value.index()));
+        if (item.value.index() == 0) {
+            writeString(out, std::get<0>(item.value));
+        } else {
+            writeBinaryTree(out, std::get<1>(item.value));
+        }
+    }
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+// Batch validation of many short strings against a regular rule.
+//
+// Checking millions of values one `identifier(value)` call at a time spends
+// nearly everything on std::function calls, Result construction and failure
+// messages. BatchValidator takes the ScanProgram of a rule (see jit.h) and
+// checks whole strings against it with no allocation per item, writing one
+// bit per item into a caller-provided bitmap.
+//
+// Each repeated step is a span of characters in a class. With SSE2 the
+// class is tested 16 bytes at a time as up to four byte ranges; the last,
+// partial block is copied into a padded buffer so nothing is read past the
+// end of an item. Classes that need more ranges use the scalar table.
+
+#include "jit.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+class BatchValidator {
+public:
+    explicit BatchValidator(const ScanProgram& program) {
+        for (auto& step : program) {
+            Step compiled{step.chars, step.required, step.repeat, {}, 0};
+            int ch = 0;
+            while (ch < 256) {
+                if (!inClass(step.chars, ch)) {
+                    ch++;
+                    continue;
+                }
+                auto start = ch;
+                while (ch < 256 && inClass(step.chars, ch)) {
+                    ch++;
+                }
+                if (compiled.rangeCount < maxRanges) {
+                    compiled.ranges[compiled.rangeCount] = {uint8_t(start), uint8_t(ch - 1)};
+                }
+                compiled.rangeCount++;
+            }
+            steps.push_back(compiled);
+        }
+    }
+
+    // Whether all of `item` matches the rule.
+    bool matches(string_view item) const {
+        size_t position = 0;
+        for (auto& step : steps) {
+            if (step.required) {
+                if (position == item.size() || !inClass(step.chars, (unsigned char)item[position])) {
+                    return false;
+                }
+                position++;
+            }
+            if (step.repeat) {
+                position += span(step, item.data() + position, item.size() - position);
+            }
+        }
+        return position == item.size();
+    }
+
+    // Sets bit i % 64 of bitmap[i / 64] when items[i] matches and clears it
+    // otherwise; bitmap holds (count + 63) / 64 words. Returns the number of
+    // matches.
+    size_t validate(const string_view* items, size_t count, uint64_t* bitmap) const {
+        size_t matched = 0;
+        for (size_t word = 0; word * 64 < count; word++) {
+            uint64_t bits = 0;
+            auto end = min(count, word * 64 + 64);
+            for (size_t i = word * 64; i < end; i++) {
+                bits |= uint64_t(matches(items[i])) << (i % 64);
+            }
+            bitmap[word] = bits;
+            matched += __builtin_popcountll(bits);
+        }
+        return matched;
+    }
+
+    vector<uint64_t> validate(const vector<string_view>& items) const {
+        vector<uint64_t> bitmap((items.size() + 63) / 64);
+        validate(items.data(), items.size(), bitmap.data());
+        return bitmap;
+    }
+
+private:
+    static const int maxRanges = 4;
+
+    struct Step {
+        CharClass chars;
+        bool required;
+        bool repeat;
+        array<pair<uint8_t, uint8_t>, maxRanges> ranges;
+        int rangeCount;
+    };
+
+    static bool inClass(const CharClass& chars, unsigned ch) {
+        return (chars[ch / 64] >> (ch % 64)) & 1;
+    }
+
+    // Length of the prefix of [data, data + size) in the class of `step`.
+    static size_t span(const Step& step, const char* data, size_t size) {
+        size_t position = 0;
+#ifdef __SSE2__
+        if (step.rangeCount <= maxRanges) {
+            while (position < size) {
+                auto remaining = size - position;
+                __m128i block;
+                if (remaining >= 16) {
+                    block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+                } else {
+                    alignas(16) char padded[16] = {};
+                    memcpy(padded, data + position, remaining);
+                    block = _mm_load_si128(reinterpret_cast<const __m128i*>(padded));
+                }
+
+                // x is in [low, high] when (x - low) ^ 0x80 is not greater
+                // than (high - low) ^ 0x80 as signed bytes.
+                auto flip = _mm_set1_epi8(char(0x80));
+                auto inside = _mm_setzero_si128();
+                for (int i = 0; i < step.rangeCount; i++) {
+                    auto& range = step.ranges[i];
+                    auto offset = _mm_xor_si128(_mm_sub_epi8(block, _mm_set1_epi8(char(range.first))), flip);
+                    auto limit = _mm_set1_epi8(char((range.second - range.first) ^ 0x80));
+                    inside = _mm_or_si128(inside, _mm_andnot_si128(_mm_cmpgt_epi8(offset, limit), _mm_set1_epi8(-1)));
+                }
+
+                auto mask = unsigned(_mm_movemask_epi8(inside));
+                if (remaining < 16) {
+                    mask &= (1u << remaining) - 1;
+                }
+                if (mask != 0xFFFF) {
+                    return position + __builtin_ctz(~mask);
+                }
+                position += 16;
+            }
+            return size;
+        }
+#endif
+        while (position < size && inClass(step.chars, (unsigned char)data[position])) {
+            position++;
+        }
+        return position;
+    }
+
+    vector<Step> steps;
+};
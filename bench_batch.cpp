@@ -0,0 +1,85 @@
+// Benchmark of batch validation against one parser call per value.
+//
+//     bench_batch [count]
+//
+// Generates `count` short values - identifiers, integers and near misses -
+// and validates them against `identifier` and `integer`, once by calling
+// the rule on each value and checking it consumed everything, and once
+// with BatchValidator. The two must agree.
+
+#include "batch.h"
+#include "grammar.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+vector<string> generateValues(size_t count) {
+    const string letters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    const string digits = "0123456789";
+    const string other = " _-.;";
+
+    mt19937 random(7);
+    vector<string> values;
+    for (size_t i = 0; i < count; i++) {
+        string value;
+        auto length = 1 + random() % 20;
+        auto kind = random() % 3;
+        for (size_t j = 0; j < length; j++) {
+            if (kind == 0) {
+                value += j == 0 || random() % 3 ? letters[random() % letters.size()] : digits[random() % digits.size()];
+            } else {
+                value += digits[random() % digits.size()];
+            }
+        }
+        if (random() % 10 == 0) {
+            value[random() % value.size()] = other[random() % other.size()];
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    size_t count = argc > 1 ? stoul(argv[1]) : 100000;
+
+    auto values = generateValues(count);
+    vector<string_view> views(values.begin(), values.end());
+
+    const pair<const char*, pair<Parser*, ScanProgram*>> rules[] = {
+        {"identifier", {&identifier, &identifierProgram}},
+        {"integer", {&integer, &integerProgram}}
+    };
+
+    for (auto& rule : rules) {
+        auto& parser = *rule.second.first;
+
+        auto start = chrono::steady_clock::now();
+        vector<bool> individually(count);
+        for (size_t i = 0; i < count; i++) {
+            auto result = parser(views[i]);
+            individually[i] = result.isSuccess() && result.rest.empty();
+        }
+        auto individualTime = millisecondsSince(start);
+
+        BatchValidator validator(*rule.second.second);
+        vector<uint64_t> bitmap((count + 63) / 64);
+        start = chrono::steady_clock::now();
+        auto matched = validator.validate(views.data(), count, bitmap.data());
+        auto batchTime = millisecondsSince(start);
+
+        for (size_t i = 0; i < count; i++) {
+            if (individually[i] != bool((bitmap[i / 64] >> (i % 64)) & 1)) {
+                cerr << rule.first << ": validators disagree on \"" << values[i] << "\"\n";
+                return 1;
+            }
+        }
+
+        printf("%-10s %zu of %zu valid   per call %9.2f ms   batch %7.2f ms\n",
+               rule.first, matched, count, individualTime, batchTime);
+    }
+}
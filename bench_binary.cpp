@@ -0,0 +1,143 @@
+// Benchmark of decoding a large binary log with the binary combinators.
+//
+//     bench_binary [megabytes] [file]
+//
+// Writes a log of `megabytes` MB (default 1024) to `file` unless it already
+// has that size, maps it read-only and decodes it with `many(record)`.
+// Without `file` the log goes to a temporary file, deleted once mapped. A
+// record is a big-endian timestamp, a level byte, a varint sequence number,
+// a varint-prefixed message and a byte-counted list of byte-prefixed tags.
+// Messages and tags are only looked at through views, never copied.
+// First checks that a count of 2^64 - 1 over a parser that matches nothing
+// ends at once.
+
+#include "binary.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint32_t logMagic = 0x474f4c42;
+
+void putInteger(string& out, IntFormat format, uint64_t value) {
+    if (format.width == 0) {
+        while (value >= 0x80) {
+            out += char(value | 0x80);
+            value >>= 7;
+        }
+        out += char(value);
+        return;
+    }
+    for (int i = 0; i < format.width; i++) {
+        auto shift = format.endian == Endian::Little ? 8 * i : 8 * (format.width - 1 - i);
+        out += char(value >> shift);
+    }
+}
+
+void writeLog(const string& path, uint64_t size) {
+    ofstream out(path, ios::binary);
+    mt19937_64 random(3);
+    string chunk;
+    putInteger(chunk, u32le, logMagic);
+
+    uint64_t written = 0, sequence = 0;
+    while (written + chunk.size() < size) {
+        putInteger(chunk, u64be, 1700000000000 + sequence * 17);
+        putInteger(chunk, u8, random() % 5);
+        putInteger(chunk, varint, sequence++);
+
+        auto message = random() % 120;
+        putInteger(chunk, varint, message);
+        chunk.append(message, char('a' + message % 26));
+
+        auto tags = random() % 4;
+        putInteger(chunk, u8, tags);
+        for (uint64_t i = 0; i < tags; i++) {
+            putInteger(chunk, u8, 6);
+            chunk += "tag-0" + to_string(i);
+        }
+
+        if (chunk.size() > 1 << 20) {
+            out.write(chunk.data(), chunk.size());
+            written += chunk.size();
+            chunk.clear();
+        }
+    }
+    out.write(chunk.data(), chunk.size());
+}
+
+int main(int argc, char** argv) {
+    string hugeCount;
+    putInteger(hugeCount, u64le, UINT64_MAX);
+    auto steps = combinatorSteps;
+    auto empty = counted(u64le, opt(binaryConstant(u8, 0xff)))(hugeCount);
+    if (empty.isFailure() || !empty.rest.empty() || combinatorSteps - steps > 100) {
+        cerr << "A huge count over empty matches did not end at once\n";
+        return 1;
+    }
+
+    uint64_t megabytes = argc > 1 ? stoull(argv[1]) : 1024;
+    bool temporary = argc <= 2;
+    string path = temporary ? "/tmp/bench_binary.log" : argv[2];
+
+    struct stat info;
+    if (temporary || stat(path.c_str(), &info) != 0 || (uint64_t(info.st_size) + (1 << 19)) >> 20 != megabytes) {
+        auto start = chrono::steady_clock::now();
+        writeLog(path, megabytes << 20);
+        printf("wrote %s in %.1f s\n", path.c_str(),
+               chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (temporary) {
+            remove(path.c_str());
+        }
+        cerr << "Cannot open " << path << "\n";
+        return 1;
+    }
+    auto address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    // The mapping keeps the data of an unlinked file.
+    if (temporary) {
+        remove(path.c_str());
+    }
+    if (address == MAP_FAILED) {
+        cerr << "Cannot map " << path << "\n";
+        return 1;
+    }
+    madvise(address, info.st_size, MADV_SEQUENTIAL);
+    string_view log(static_cast<const char*>(address), info.st_size);
+
+    size_t records = 0, errors = 0;
+    uint64_t messageBytes = 0;
+
+    auto record = onMatch(sequence({
+        binaryInteger(u64be),
+        onMatch(binaryInteger(u8), [&](string_view level) { errors += decode(u8, level) == 4; }),
+        binaryInteger(varint),
+        onMatch(blob(varint), [&](string_view message) { messageBytes += payload(varint, message).size(); }),
+        counted(u8, blob(u8))
+    }), [&](string_view) { records++; });
+
+    auto logParser = sequence({binaryConstant(u32le, logMagic), many(record)});
+
+    auto start = chrono::steady_clock::now();
+    auto result = logParser(log);
+    auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (result.isFailure() || !result.rest.empty()) {
+        cerr << "Decoding stopped " << (log.size() - result.rest.size()) << " bytes in: " << result.error << "\n";
+        return 1;
+    }
+
+    printf("%zu records, %zu errors, %llu message bytes\n", records, errors, (unsigned long long)messageBytes);
+    printf("%.2f s, %.1f MB/s, %.1f M records/s\n", seconds, log.size() / seconds / 1e6, records / seconds / 1e6);
+    munmap(address, info.st_size);
+}
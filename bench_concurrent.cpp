@@ -0,0 +1,107 @@
+// Tail-latency benchmark under concurrent parsing load.
+//
+//     bench_concurrent [seconds-per-level] [max-threads]
+//
+// For 1, 2, 4, ... up to max-threads threads, every thread parses documents
+// from a mixed-size corpus back to back and records each parse's latency
+// in its own histogram. The histograms are merged per level and reported as
+// percentiles alongside total and per-thread throughput.
+
+#include "grammar.h"
+#include "histogram.h"
+#include "sample.h"
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+// Small, medium and large documents, weighted towards the small ones the
+// way production traffic is.
+vector<string> buildCorpus() {
+    vector<string> corpus;
+    const pair<int, int> mix[] = {{1, 6}, {4, 3}, {32, 1}};
+
+    for (auto& entry : mix) {
+        string document;
+        for (int i = 0; i < entry.first; i++) {
+            document += sampleSource;
+        }
+        for (int i = 0; i < entry.second; i++) {
+            corpus.push_back(document);
+        }
+    }
+    return corpus;
+}
+
+// Each worker's histogram, counters included, on its own cache lines, so
+// recording a latency never contends with another thread.
+struct alignas(64) WorkerHistogram {
+    Histogram histogram;
+};
+
+uint64_t nanosecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? stod(argv[1]) : 2.0;
+    unsigned maxThreads = argc > 2 ? stoul(argv[2]) : 32;
+
+    auto corpus = buildCorpus();
+
+    cout << setw(8) << "threads" << setw(12) << "parses/s" << setw(14) << "per thread"
+         << setw(10) << "p50 us" << setw(10) << "p90 us" << setw(10) << "p99 us"
+         << setw(10) << "p999 us" << setw(10) << "max us" << "\n";
+
+    for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+        vector<WorkerHistogram> histograms(threads);
+        vector<thread> workers;
+        atomic<bool> running{true};
+        atomic<unsigned> ready{0};
+
+        for (unsigned index = 0; index < threads; index++) {
+            workers.emplace_back([&, index]() {
+                auto& histogram = histograms[index].histogram;
+                size_t next = index;
+
+                ready++;
+                while (ready < threads) {
+                    this_thread::yield();
+                }
+
+                while (running.load(memory_order_relaxed)) {
+                    auto& document = corpus[next++ % corpus.size()];
+                    auto start = chrono::steady_clock::now();
+                    parse(document);
+                    histogram.record(nanosecondsSince(start));
+                }
+            });
+        }
+
+        while (ready < threads) {
+            this_thread::yield();
+        }
+        auto start = chrono::steady_clock::now();
+        this_thread::sleep_for(chrono::duration<double>(seconds));
+        running = false;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        auto elapsed = nanosecondsSince(start) / 1e9;
+
+        Histogram merged;
+        for (auto& worker : histograms) {
+            merged.merge(worker.histogram);
+        }
+
+        auto throughput = merged.count() / elapsed;
+        cout << setw(8) << threads << fixed << setprecision(0)
+             << setw(12) << throughput << setw(14) << throughput / threads << setprecision(1)
+             << setw(10) << merged.percentile(50) / 1000.0
+             << setw(10) << merged.percentile(90) / 1000.0
+             << setw(10) << merged.percentile(99) / 1000.0
+             << setw(10) << merged.percentile(99.9) / 1000.0
+             << setw(10) << merged.max() / 1000.0 << "\n";
+    }
+}
@@ -0,0 +1,91 @@
+// Benchmark of the continuation-passing engine against the Result engine.
+//
+//     bench_cps [repeat]
+//
+// Both engines parse the same documents: the sample program, the sample
+// repeated 64 times, and a few inputs that fail part-way. The printed
+// results must be identical, with and without AST shaping; then each engine
+// parses every document `repeat` times and the median time, throughput and
+// allocations per parse are reported side by side.
+
+#include "alloc_counter.h"
+#include "cps_grammar.h"
+#include "grammar.h"
+#include "sample.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+struct Measurement {
+    double nanoseconds;
+    double allocations;
+};
+
+template <typename ParseFunction>
+Measurement measure(const string& document, int repeat, ParseFunction parseDocument) {
+    vector<double> times;
+    auto allocations = allocationCount;
+    for (int i = 0; i < repeat; i++) {
+        auto start = chrono::steady_clock::now();
+        parseDocument(document);
+        times.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    return Measurement{times[times.size() / 2], double(allocationCount - allocations) / repeat};
+}
+
+string printed(const Result& result) {
+    stringstream out;
+    out << result;
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    int repeat = argc > 1 ? stoi(argv[1]) : 50;
+
+    string large;
+    for (int i = 0; i < 64; i++) {
+        large += sampleSource;
+    }
+
+    const pair<string, string> documents[] = {
+        {"sample", sampleSource},
+        {"sample x64", large},
+        {"truncated", sampleSource.substr(0, sampleSource.size() / 2)},
+        {"bad parameter", "function f (int a,) { if a + (b { } }"},
+        {"bad const", "const x = y"}
+    };
+
+    cps::Context context;
+    auto cpsParse = [&context](const string& document) {
+        return cps::run(cps::grammar::parse, document, context);
+    };
+
+    bool same = true;
+    for (auto shape : {AstShape{}, AstShape{true, true}}) {
+        astShape = shape;
+        for (auto& document : documents) {
+            if (printed(parse(document.second)) != printed(cpsParse(document.second))) {
+                cerr << "Engines disagree on " << document.first << "\n";
+                same = false;
+            }
+        }
+    }
+    astShape = AstShape{};
+    if (!same) {
+        return 1;
+    }
+
+    printf("%-14s %12s %12s %10s %12s %12s %10s\n", "document",
+           "result us", "result MB/s", "allocs", "cps us", "cps MB/s", "allocs");
+    for (auto& document : documents) {
+        auto resultEngine = measure(document.second, repeat, [](const string& text) { parse(text); });
+        auto cpsEngine = measure(document.second, repeat, cpsParse);
+        auto megabytes = [&](double nanoseconds) { return document.second.size() * 1000.0 / nanoseconds; };
+
+        printf("%-14s %12.1f %12.2f %10.0f %12.1f %12.2f %10.0f\n", document.first.c_str(),
+               resultEngine.nanoseconds / 1000.0, megabytes(resultEngine.nanoseconds), resultEngine.allocations,
+               cpsEngine.nanoseconds / 1000.0, megabytes(cpsEngine.nanoseconds), cpsEngine.allocations);
+    }
+}
@@ -0,0 +1,103 @@
+// Checks and measures the concrete syntax tree of cst.h.
+//
+//     bench_cst [repeat]
+//
+// The text of the tree must reproduce its input byte for byte: the sample
+// program, every prefix of it and the sample followed by a tail the grammar
+// cannot parse. Reparsing the sample after changing one literal must reuse
+// all but a few green nodes, and tokenAt() must find the token at every
+// offset. A rule that matched inside an alternative which then failed must
+// leave no node behind. Then reports the time of a CST parse against a
+// plain parse.
+
+#include "bench_timing.h"
+#include "cst.h"
+#include "grammar.h"
+#include "sample.h"
+
+#include <algorithm>
+
+bool roundTrips(const string& input) {
+    GreenInterner interner;
+    auto cst = parseCst(parse, input, interner);
+    string text;
+    appendText(cst.root, text);
+    if (text != input) {
+        cerr << "Round trip differs for input of " << input.size() << " bytes\n";
+        return false;
+    }
+    return true;
+}
+
+// Nodes of kind `name` anywhere below `node`.
+size_t countKind(const GreenNode* node, uint32_t kind) {
+    size_t count = !node->isToken && node->kind == kind;
+    for (auto child : node->children) {
+        count += countKind(child, kind);
+    }
+    return count;
+}
+
+// "a" followed by "x" or "y"; on "ay" the first alternative matches its
+// named "a" and then fails.
+bool dropsBacktrackedNodes() {
+    auto letter = mapTo(parseChar('a'), "letter");
+    auto grammar = choice({
+        sequence({letter, parseChar('x')}),
+        sequence({parseChar('a'), parseChar('y')}),
+        many1(sequence({letter, parseChar('z')}))
+    });
+    GreenInterner interner;
+    auto letterKind = interner.kind("letter");
+    if (countKind(parseCst(grammar, "ay", interner).root, letterKind) != 0 ||
+        countKind(parseCst(grammar, "azazay", interner).root, letterKind) != 2) {
+        cerr << "A backtracked rule left a node in the tree\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int repeat = argc > 1 ? stoi(argv[1]) : 20;
+    bool ok = dropsBacktrackedNodes() && roundTrips(sampleSource) && roundTrips(sampleSource + "\n}} struct { @@ 12 (\n");
+    size_t prefixes = 0;
+    for (size_t length = 0; ok && length <= sampleSource.size(); length++) {
+        ok = roundTrips(sampleSource.substr(0, length));
+        prefixes++;
+    }
+    if (!ok) {
+        return 1;
+    }
+    cout << "round trip: sample, " << prefixes << " prefixes and an unparsable tail\n";
+
+    GreenInterner interner;
+    auto first = parseCst(parse, sampleSource, interner);
+    auto nodes = interner.size();
+
+    auto edited = sampleSource;
+    edited.replace(edited.find("100"), 3, "101");
+    auto second = parseCst(parse, edited, interner);
+    auto added = interner.size() - nodes;
+    cout << nodes << " green nodes, " << added << " new after changing one literal\n";
+    if (first.root == second.root || added > 8) {
+        cerr << "Expected a new root and only the path to the literal to be new\n";
+        return 1;
+    }
+
+    RedNode root(second.root);
+    for (size_t position = 0; position < edited.size(); position++) {
+        auto token = root.tokenAt(position);
+        if (!token.node()->isToken || position < token.offset() || position >= token.end() ||
+            edited[position] != token.text()[position - token.offset()]) {
+            cerr << "tokenAt(" << position << ") is wrong\n";
+            return 1;
+        }
+    }
+
+    auto plain = medianMicroseconds(repeat, [&]() { parse(sampleSource); });
+    auto withCst = medianMicroseconds(repeat, [&]() {
+        GreenInterner fresh;
+        parseCst(parse, sampleSource, fresh);
+    });
+    cout << "parse " << plain << " us, parse with CST " << withCst << " us\n";
+}
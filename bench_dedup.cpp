@@ -0,0 +1,81 @@
+// Checks and measures the hash-consed AST of dedup.h.
+//
+//     bench_dedup [copies] [repeat]
+//
+// Parses `copies` copies of one struct and of the sample program. Interning
+// either must keep at most one node more than interning a single copy does,
+// the node being the root that holds the copies, and expanding the interned
+// nodes must give back the parsed tree. Then reports the nodes kept against
+// those interned, and the time of a parse against that of interning its
+// result.
+
+#include "bench_timing.h"
+#include "dedup.h"
+#include "grammar.h"
+#include "sample.h"
+
+#include <algorithm>
+
+bool sameTree(const ResultMap& a, const ResultMap& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].name != b[i].name || a[i].value.index() != b[i].value.index()) {
+            return false;
+        }
+        if (a[i].value.index() == 0 ? std::get<0>(a[i].value) != std::get<0>(b[i].value)
+                                    : !sameTree(std::get<1>(a[i].value), std::get<1>(b[i].value))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Interns `copies` copies of `unit` and checks the result. Only the root
+// differs from that of one copy, so the pool may keep one node more.
+bool check(const string& label, const string& unit, int copies) {
+    AstPool single;
+    single.intern(parse(unit).results);
+
+    string source;
+    for (int i = 0; i < copies; i++) {
+        source += unit;
+    }
+    auto result = parse(source);
+    AstPool pool;
+    auto nodes = pool.intern(result.results);
+    cout << label << ": " << copies << " copies intern " << pool.internedCount() << " nodes into "
+         << pool.size() << " distinct ones\n";
+    if (pool.size() > single.size() + 1 || pool.internedCount() != copies * (single.internedCount() - 1) + 1) {
+        cerr << "Expected every copy interned and no more distinct nodes than one copy has\n";
+        return false;
+    }
+    if (!sameTree(expand(nodes), result.results)) {
+        cerr << "Expanded nodes differ from the parse\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int copies = argc > 1 ? stoi(argv[1]) : 50;
+    int repeat = argc > 2 ? stoi(argv[2]) : 20;
+
+    auto structSource = "\n        struct Triangle {\n            Point a;\n            Point b;\n            Point c;\n        }\n";
+    if (!check("struct", structSource, copies) || !check("sample", sampleSource, copies)) {
+        return 1;
+    }
+
+    string source;
+    for (int i = 0; i < copies; i++) {
+        source += sampleSource;
+    }
+    auto result = parse(source);
+    auto parseUs = medianMicroseconds(max(1, repeat / 10), [&]() { parse(source); });
+    auto internUs = medianMicroseconds(repeat, [&]() {
+        AstPool pool;
+        pool.intern(result.results);
+    });
+    cout << "parse " << parseUs << " us, intern " << internUs << " us\n";
+}
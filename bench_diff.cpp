@@ -0,0 +1,79 @@
+// Benchmark of diffing two parses of an edited document.
+//
+//     bench_diff [copies] [repeat]
+//
+// Parses the sample program repeated `copies` times, and a copy of it with
+// four edits: a field renamed, a constant inserted, a function removed and
+// a number in an expression changed. The diff of the two parses must be
+// exactly those edits, and the diff of a parse with itself must be empty,
+// with subtree hashes and without.
+// Prints the edit script, the nodes the diff visited against the size of
+// the tree, and the median time of a diff against that of a parse.
+
+#include "ast_diff.h"
+#include "bench_timing.h"
+#include "grammar.h"
+#include "sample.h"
+
+#include <algorithm>
+
+size_t countNodes(const ResultMap& items) {
+    size_t count = items.size();
+    for (auto& item : items) {
+        if (auto children = ast_diff::childrenOf(item)) {
+            count += countNodes(*children);
+        }
+    }
+    return count;
+}
+
+void replaceAt(string& text, size_t from, const string& before, const string& after) {
+    auto position = text.find(before, from);
+    text.replace(position, before.size(), after);
+}
+
+int main(int argc, char** argv) {
+    int copies = argc > 1 ? stoi(argv[1]) : 64;
+    int repeat = argc > 2 ? stoi(argv[2]) : 20;
+
+    string original;
+    for (int i = 0; i < copies; i++) {
+        original += sampleSource;
+    }
+    auto edited = original;
+    auto middle = sampleSource.size() * (copies / 2);
+    replaceAt(edited, middle, "int y;", "int z;");
+    replaceAt(edited, middle, "struct Line", "const z = 300\n        struct Line");
+    replaceAt(edited, middle, "function toString() { }", "");
+    replaceAt(edited, sampleSource.size() * (copies - 1), "1000", "2000");
+
+    auto unhashed = parse(original);
+    subtreeHashes = true;
+    auto before = parse(original);
+    auto after = parse(edited);
+    auto same = parse(original);
+
+    ast_diff::Differ differ;
+    differ.children(before.results, after.results, "");
+    writeEdits(cout, differ.edits);
+
+    size_t changed = 0, inserted = 0, removed = 0;
+    for (auto& edit : differ.edits) {
+        changed += edit.kind == EditKind::Changed;
+        inserted += edit.kind == EditKind::Inserted;
+        removed += edit.kind == EditKind::Removed;
+    }
+    auto unchanged = diffResults(before.results, same.results);
+    auto walked = diffResults(unhashed.results, same.results);
+    if (changed != 2 || inserted != 1 || removed != 1 || !unchanged.empty() || !walked.empty()) {
+        cerr << "Unexpected edit script\n";
+        return 1;
+    }
+
+    cout << countNodes(before.results) << " nodes, " << differ.compared << " compared, "
+         << differ.skipped << " skipped as equal by hash\n";
+
+    auto diffNs = medianNanoseconds(repeat, [&]() { diffResults(before.results, after.results); });
+    auto parseNs = medianNanoseconds(max(1, repeat / 10), [&]() { parse(edited); });
+    cout << "diff " << diffNs / 1000.0 << " us, parse " << parseNs / 1000.0 << " us\n";
+}
@@ -0,0 +1,132 @@
+// Benchmark of compiled condition evaluation against walking the AST.
+//
+//     bench_expressions [rows]
+//
+// Parses the sample program with its `const` declarations and a condition
+// over the sample's variables, compiles every `if` condition and evaluates
+// it for `rows` random bindings three ways: walking the parsed tree with a
+// map of variable values, running the bytecode one row at a time, and
+// running it over the whole batch. All three must agree. A sum of more
+// variables than 16-bit slots can number must be rejected, not miscompiled.
+
+#include "bytecode.h"
+#include "grammar.h"
+#include "sample.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+// The straightforward evaluator the bytecode replaces.
+int64_t walk(const ResultItem& node, const map<string, int64_t>& bindings) {
+    if (node.value.index() == 0) {
+        auto& text = std::get<0>(node.value);
+        if (isdigit((unsigned char)text[0])) {
+            return stoll(text);
+        }
+        return bindings.at(text);
+    }
+
+    auto& children = std::get<1>(node.value);
+    if (!bytecode::isExpressionNode(node.name)) {
+        return walk(children[0], bindings);
+    }
+
+    auto result = walk(children[0], bindings);
+    for (size_t i = 1; i < children.size(); i++) {
+        auto& parts = std::get<1>(children[i].value);
+        auto op = bytecode::binaryOp(std::get<0>(parts[0].value));
+        result = bytecode::apply(op, result, walk(parts[1], bindings));
+    }
+    return result;
+}
+
+double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// `count` distinct variables added together, as `expression` shapes it.
+ResultItem longSum(size_t count) {
+    vector<ResultItem> children {ResultItem {"left", string("v0")}};
+    for (size_t i = 1; i < count; i++) {
+        children.push_back(ResultItem {"item", vector<ResultItem> {
+            ResultItem {"operator", string("+")},
+            ResultItem {"right", "v" + to_string(i)}
+        }});
+    }
+    return ResultItem {"AddExpression", std::move(children)};
+}
+
+int main(int argc, char** argv) {
+    size_t rows = argc > 1 ? stoul(argv[1]) : 1000000;
+
+    if (!compileExpression(longSum(1000)).valid() || compileExpression(longSum(70000)).valid()) {
+        cerr << "Register and slot limits not enforced\n";
+        return 1;
+    }
+
+    auto source = sampleSource + R""(
+        function check (int a, int b, int c) {
+            if a * 2 + x - y / 2 == b - c {
+            }
+        }
+    )"";
+
+    auto result = parse(source);
+    auto constants = constantsOf(result.results);
+
+    mt19937_64 random(42);
+    for (auto condition : conditionsOf(result.results)) {
+        auto program = compileExpression(*condition, constants);
+        if (!program.valid()) {
+            cerr << "Cannot compile condition: " << program.error << "\n";
+            return 1;
+        }
+
+        vector<vector<int64_t>> columns(program.variables.size(), vector<int64_t>(rows));
+        vector<const int64_t*> columnPointers;
+        for (auto& column : columns) {
+            for (auto& value : column) {
+                value = int64_t(random() % 41) - 20;
+            }
+            columnPointers.push_back(column.data());
+        }
+
+        // Constants are bindings too for the tree walker.
+        map<string, int64_t> bindings(constants.begin(), constants.end());
+        vector<int64_t> walked(rows), single(rows), batched(rows);
+
+        auto start = chrono::steady_clock::now();
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t v = 0; v < columns.size(); v++) {
+                bindings[program.variables[v]] = columns[v][row];
+            }
+            walked[row] = walk(*condition, bindings);
+        }
+        auto walkTime = millisecondsSince(start);
+
+        start = chrono::steady_clock::now();
+        vector<int64_t> variables(columns.size());
+        for (size_t row = 0; row < rows; row++) {
+            for (size_t v = 0; v < columns.size(); v++) {
+                variables[v] = columns[v][row];
+            }
+            single[row] = evaluate(program, variables.data());
+        }
+        auto singleTime = millisecondsSince(start);
+
+        start = chrono::steady_clock::now();
+        evaluateBatch(program, columnPointers.data(), rows, batched.data());
+        auto batchTime = millisecondsSince(start);
+
+        if (walked != single || walked != batched) {
+            cerr << "Evaluators disagree\n";
+            return 1;
+        }
+
+        size_t matches = count(batched.begin(), batched.end(), 1);
+        printf("%zu instructions, %zu variables, %zu of %zu rows true\n",
+               program.code.size(), program.variables.size(), matches, rows);
+        printf("    tree walk %9.2f ms   bytecode %8.2f ms   batch %8.2f ms\n", walkTime, singleTime, batchTime);
+    }
+}
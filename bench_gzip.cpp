@@ -0,0 +1,99 @@
+// Benchmark of streaming gzip input against decompressing first.
+//
+//     bench_gzip [copies] [file.gz]
+//
+// Writes the sample program repeated `copies` times to a temporary gzip
+// file (unless one is given), then parses it twice: decompressed into a
+// string and parsed with `parse`, and streamed through an InputWindow
+// declaration by declaration. The declarations must match, and the window
+// must stay smaller than the input; time and peak input memory of both are
+// reported. The default input is about 500 KB, four times the window.
+
+#include "gzip_input.h"
+#include "sample.h"
+
+#include <chrono>
+#include <cstdio>
+
+double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+string printed(const ResultMap& items) {
+    auto result = Result::success("", "");
+    result.results = items;
+    stringstream out;
+    out << result;
+    return out.str();
+}
+
+int main(int argc, char** argv) {
+    int copies = argc > 1 ? stoi(argv[1]) : 1000;
+    string path = argc > 2 ? argv[2] : "/tmp/bench_gzip.src.gz";
+
+    if (argc <= 2) {
+        auto file = gzopen(path.c_str(), "wb");
+        if (file == nullptr) {
+            cerr << "Cannot write " << path << "\n";
+            return 1;
+        }
+        bool written = true;
+        for (int i = 0; i < copies; i++) {
+            written = written && gzwrite(file, sampleSource.data(), unsigned(sampleSource.size())) > 0;
+        }
+        if (gzclose(file) != Z_OK || !written) {
+            cerr << "Cannot write " << path << "\n";
+            remove(path.c_str());
+            return 1;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    string whole;
+    GzipSource source(path);
+    string error;
+    char buffer[64 * 1024];
+    while (auto count = source(buffer, sizeof(buffer), error)) {
+        whole.append(buffer, count);
+    }
+    auto full = parse(whole);
+    auto wholeTime = millisecondsSince(start);
+
+    // Declarations as `parse` returns them, under "ast" and its items.
+    vector<string> expected;
+    if (!full.results.empty() && full.results[0].value.index() == 1) {
+        for (auto& item : std::get<1>(full.results[0].value)) {
+            expected.push_back(printed(item.value.index() == 1 ? std::get<1>(item.value) : ResultMap{item}));
+        }
+    }
+
+    start = chrono::steady_clock::now();
+    size_t index = 0;
+    bool same = true;
+    auto summary = parseGzipDeclarations(path, [&](Result&& declaration) {
+        same = same && index < expected.size() && printed(declaration.results) == expected[index];
+        index++;
+    });
+    auto streamTime = millisecondsSince(start);
+    if (argc <= 2) {
+        remove(path.c_str());
+    }
+
+    if (!summary.parsed) {
+        cerr << "Streaming parse failed: " << summary.error << "\n";
+        return 1;
+    }
+    if (!same || index != expected.size()) {
+        cerr << "Streamed declarations differ from parse\n";
+        return 1;
+    }
+    if (summary.peakWindow >= whole.size()) {
+        cerr << "Input window of " << summary.peakWindow << " bytes is not smaller than the "
+             << whole.size() << " byte input\n";
+        return 1;
+    }
+
+    printf("%zu declarations, %zu bytes decompressed\n", summary.declarations, whole.size());
+    printf("decompress then parse %9.2f ms, input buffer %zu bytes\n", wholeTime, whole.capacity());
+    printf("streaming parse       %9.2f ms, input window %zu bytes\n", streamTime, summary.peakWindow);
+}
@@ -0,0 +1,109 @@
+// Stress test and benchmark of grammar replacement during parsing.
+//
+//     bench_hot_swap [threads] [milliseconds]
+//
+// Builds the grammar of grammar.h with makeGrammar() in two dialects, one
+// comparing with == and != and one with < and >. Reader threads parse a
+// document continuously through a GrammarHandle while a writer keeps
+// building and publishing the other dialect, pausing 100 microseconds
+// between versions; building one takes longer than that, so the interval
+// between versions is reported. Every result must be the one its grammar
+// version produces on its own. Reports parses per second, versions
+// published and reclaimed, and the cost of a parse through the handle
+// against calling the grammar directly.
+
+#include "grammar.h"
+#include "grammar_handle.h"
+
+#include <chrono>
+#include <thread>
+
+unique_ptr<Grammar> dialect(uint64_t version) {
+    return version % 2 == 1 ? makeGrammar("==", "!=") : makeGrammar("<", ">");
+}
+
+string printed(const Result& result) {
+    stringstream out;
+    out << result;
+    return out.str();
+}
+
+// Both dialects parse the first function; each stops at the function
+// written in the other one.
+const string document =
+    "function h(int n) { if n * 2 + 1 { for i in n { } } }\n"
+    "function f() { if a == b { if x + 1 * 2 != y { } } }\n"
+    "function g() { if a < b { if c > d - 3 { } } }\n";
+
+int main(int argc, char** argv) {
+    size_t threads = argc > 1 ? stoi(argv[1]) : max(2u, thread::hardware_concurrency());
+    int milliseconds = argc > 2 ? stoi(argv[2]) : 1000;
+
+    // What each dialect parses the document to, indexed by version parity.
+    string expected[2] = {
+        printed(dialect(0)->start(document)),
+        printed(dialect(1)->start(document))
+    };
+    if (expected[0] == expected[1]) {
+        cerr << "The dialects should parse the document differently\n";
+        return 1;
+    }
+
+    GrammarHandle handle(dialect(1));
+    atomic<bool> stop{false};
+    atomic<size_t> parses{0}, mismatches{0};
+
+    vector<thread> readers;
+    for (size_t t = 0; t < threads; t++) {
+        readers.emplace_back([&]() {
+            size_t count = 0;
+            while (!stop.load(memory_order_relaxed)) {
+                auto same = handle.read([&](const Grammar& grammar) {
+                    return printed(grammar.start(document)) == expected[grammar.version % 2];
+                });
+                if (!same) {
+                    mismatches++;
+                }
+                count++;
+            }
+            parses += count;
+        });
+    }
+
+    size_t published = 1, maxPending = 0;
+    auto start = chrono::steady_clock::now();
+    auto end = start + chrono::milliseconds(milliseconds);
+    while (chrono::steady_clock::now() < end) {
+        this_thread::sleep_for(chrono::microseconds(100));
+        handle.publish(dialect(++published));
+        maxPending = max(maxPending, handle.reclaim());
+    }
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    auto pending = handle.reclaim();
+
+    cout << threads << " readers, " << parses.load() << " parses, "
+         << size_t(parses.load() / seconds) << " parses/s, " << mismatches.load() << " mismatches\n";
+    cout << published << " versions published, one every " << size_t(seconds * 1e6 / published)
+         << " us, at most " << maxPending << " awaiting reclamation, " << pending
+         << " left after the readers stopped\n";
+
+    // Single-threaded cost of going through the handle.
+    auto direct = dialect(published);
+    const int repeat = 500;
+    auto time = [&](auto parseOnce) {
+        auto begin = chrono::steady_clock::now();
+        for (int i = 0; i < repeat; i++) {
+            parseOnce();
+        }
+        return chrono::duration<double, nano>(chrono::steady_clock::now() - begin).count() / repeat;
+    };
+    auto directNs = time([&]() { direct->start(document); });
+    auto handleNs = time([&]() { handle.parse(document); });
+    cout << "direct " << size_t(directNs) << " ns, through handle " << size_t(handleNs) << " ns per parse\n";
+
+    return mismatches.load() == 0 && pending == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+// Benchmark of predictive choices against ordered choices.
+//
+//     bench_predictive [repeat] [mutations]
+//
+// Prints which choices of the grammar are LL(1), then checks that both
+// modes agree - printed result, error and sawEndOfInput - on the sample
+// program, its prefixes and `mutations` randomly mutated copies of it.
+// Finally each mode parses the documents `repeat` times and the median
+// time and combinator steps per parse are reported side by side.
+
+#include "grammar.h"
+#include "sample.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+struct Outcome {
+    string printed;
+    string error;
+    bool sawEnd;
+};
+
+Outcome run(const string& document, bool predictiveMode) {
+    predictiveParsing = predictiveMode;
+    sawEndOfInput = false;
+    auto result = parse(document);
+    stringstream out;
+    out << result;
+    Outcome outcome{out.str(), result.error, sawEndOfInput};
+    predictiveParsing = true;
+    return outcome;
+}
+
+bool agree(const string& document) {
+    auto predicted = run(document, true);
+    auto ordered = run(document, false);
+    return predicted.printed == ordered.printed && predicted.error == ordered.error &&
+           predicted.sawEnd == ordered.sawEnd;
+}
+
+string mutate(string document, mt19937& random) {
+    const string alphabet = "abfinorstuc0123456789{}();,=+-*/!  \n";
+    auto edits = 1 + random() % 4;
+    for (size_t i = 0; i < edits && !document.empty(); i++) {
+        auto position = random() % document.size();
+        switch (random() % 3) {
+        case 0:
+            document.erase(position, 1 + random() % 8);
+            break;
+        case 1:
+            document.insert(position, 1, alphabet[random() % alphabet.size()]);
+            break;
+        default:
+            document[position] = alphabet[random() % alphabet.size()];
+        }
+    }
+    return document;
+}
+
+struct Measurement {
+    double nanoseconds;
+    size_t steps;
+};
+
+Measurement measure(const string& document, int repeat, bool predictiveMode) {
+    predictiveParsing = predictiveMode;
+    vector<double> times;
+    combinatorSteps = 0;
+    for (int i = 0; i < repeat; i++) {
+        auto start = chrono::steady_clock::now();
+        parse(document);
+        times.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+    }
+    predictiveParsing = true;
+    sort(times.begin(), times.end());
+    return Measurement{times[times.size() / 2], combinatorSteps / repeat};
+}
+
+int main(int argc, char** argv) {
+    int repeat = argc > 1 ? stoi(argv[1]) : 50;
+    int mutations = argc > 2 ? stoi(argv[2]) : 2000;
+
+    reportPredictive(cout);
+
+    size_t checked = 0, disagreements = 0;
+    auto check = [&](const string& document) {
+        checked++;
+        if (!agree(document)) {
+            disagreements++;
+            cerr << "Modes disagree on:\n" << document << "\n";
+        }
+    };
+    for (size_t length = 0; length <= sampleSource.size(); length += 7) {
+        check(sampleSource.substr(0, length));
+    }
+    mt19937 random(1);
+    for (int i = 0; i < mutations; i++) {
+        check(mutate(sampleSource, random));
+    }
+    cout << checked << " documents checked, " << disagreements << " disagreements\n";
+    if (disagreements > 0) {
+        return 1;
+    }
+
+    string large;
+    for (int i = 0; i < 64; i++) {
+        large += sampleSource;
+    }
+    const pair<string, string> documents[] = {
+        {"sample", sampleSource},
+        {"sample x64", large},
+        {"truncated", sampleSource.substr(0, sampleSource.size() / 2)}
+    };
+
+    printf("%-12s %12s %10s %14s %10s\n", "document", "ordered us", "steps", "predictive us", "steps");
+    for (auto& document : documents) {
+        auto ordered = measure(document.second, repeat, false);
+        auto predicted = measure(document.second, repeat, true);
+        printf("%-12s %12.1f %10zu %14.1f %10zu\n", document.first.c_str(),
+               ordered.nanoseconds / 1000.0, ordered.steps,
+               predicted.nanoseconds / 1000.0, predicted.steps);
+    }
+}
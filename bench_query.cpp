@@ -0,0 +1,129 @@
+// Checks and measures the indexed queries of query.h.
+//
+//     bench_query [copies] [repeat]
+//
+// Parses the sample program repeated `copies` times and checks that every
+// selector below matches as many nodes through the index as a walk of the
+// whole tree finds. Then reports the time to parse, to build the index, and
+// to answer each selector through the index and by walking the tree.
+
+#include "bench_timing.h"
+#include "grammar.h"
+#include "query.h"
+#include "sample.h"
+
+#include <algorithm>
+
+// Whether the names on a path from the root, "item" wrappers left out,
+// match `steps` with the last name being the node itself.
+bool matchesPath(const vector<pair<string, bool>>& steps, size_t step,
+                 const vector<string>& path, size_t position) {
+    if (path[position] != steps[step].first) {
+        return false;
+    }
+    if (step == 0) {
+        return true;
+    }
+    for (size_t ancestor = position; ancestor-- > 0;) {
+        if (matchesPath(steps, step - 1, path, ancestor)) {
+            return true;
+        }
+        if (steps[step].second) {
+            return false;
+        }
+    }
+    return false;
+}
+
+void walk(const ResultMap& items, vector<string>& path, const vector<pair<string, bool>>& steps,
+          size_t& matches) {
+    for (auto& item : items) {
+        auto wrapper = item.name == "item";
+        if (!wrapper) {
+            path.push_back(item.name);
+            if (matchesPath(steps, steps.size() - 1, path, path.size() - 1)) {
+                matches++;
+            }
+        }
+        if (item.value.index() == 1) {
+            walk(std::get<1>(item.value), path, steps, matches);
+        }
+        if (!wrapper) {
+            path.pop_back();
+        }
+    }
+}
+
+// The selector as (name, is-child-of-previous) steps.
+vector<pair<string, bool>> steps(const string& selector) {
+    vector<pair<string, bool>> result;
+    stringstream in(selector);
+    string word;
+    bool child = false;
+    while (in >> word) {
+        if (word == ">") {
+            child = true;
+        } else {
+            result.push_back({word, child});
+            child = false;
+        }
+    }
+    return result;
+}
+
+size_t walkCount(const ResultMap& results, const string& selector) {
+    vector<string> path;
+    size_t matches = 0;
+    walk(results, path, steps(selector), matches);
+    return matches;
+}
+
+int main(int argc, char** argv) {
+    int copies = argc > 1 ? stoi(argv[1]) : 64;
+    int repeat = argc > 2 ? stoi(argv[2]) : 20;
+
+    string source;
+    for (int i = 0; i < copies; i++) {
+        source += sampleSource;
+    }
+
+    auto indexed = parseIndexed(parse, source);
+    auto& results = indexed.result.results;
+    auto& index = indexed.index;
+
+    const string selectors[] = {
+        "struct > function > parameters",
+        "function parameter",
+        "parameters > parameter",
+        "struct name",
+        "struct > name",
+        "if condition MulExpression",
+        "ast > const > value",
+        "function > if > type"
+    };
+
+    bool ok = true;
+    for (auto& selector : selectors) {
+        auto found = index.select(selector).size();
+        auto expected = walkCount(results, selector);
+        if (found != expected || expected == 0) {
+            cerr << selector << ": index found " << found << ", walk found " << expected << "\n";
+            ok = false;
+        }
+    }
+    if (!ok) {
+        return 1;
+    }
+
+    auto parseUs = medianMicroseconds(max(1, repeat / 10), [&]() { parse(source); });
+    auto indexUs = medianMicroseconds(repeat, [&]() { AstIndex rebuilt(results); });
+    cout << index.size() << " nodes, parse " << parseUs << " us, index " << indexUs << " us\n";
+
+    for (auto& selector : selectors) {
+        size_t matches = 0;
+        auto queryUs = medianMicroseconds(repeat, [&]() { matches = index.select(selector).size(); });
+        auto walkUs = medianMicroseconds(repeat, [&]() { walkCount(results, selector); });
+        printf("%-32s %6zu matches %10.1f us indexed %10.1f us walked\n",
+               selector.c_str(), matches, queryUs, walkUs);
+    }
+}
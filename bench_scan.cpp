@@ -0,0 +1,55 @@
+// Benchmark of the scan combinators against skipping byte by byte.
+//
+//     bench_scan [kilobytes]
+//
+// Skips a block comment body of `kilobytes` KB (default 256) up to "*/",
+// and a line up to "\n", once with takeUntil / takeUntilAny and once with
+// many(sequence({notFollowedBy(delimiter), anyChar()})). Both must stop at
+// the same place.
+
+#include "scan.h"
+
+#include <chrono>
+#include <cstdio>
+
+double microsecondsFor(const Parser& parser, string_view input, string_view& rest) {
+    auto start = chrono::steady_clock::now();
+    auto result = parser(input);
+    auto elapsed = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    rest = result.isSuccess() ? result.rest : string_view();
+    return elapsed;
+}
+
+int main(int argc, char** argv) {
+    size_t kilobytes = argc > 1 ? stoul(argv[1]) : 256;
+
+    string body;
+    while (body.size() < kilobytes * 1024) {
+        body += "some commented-out code * with / stars and slashes\n";
+    }
+
+    const pair<const char*, pair<string, Parser>> cases[] = {
+        {"block comment", {body + "*/ int x;", takeUntil("*/")}},
+        {"line", {string(body.size(), 'x') + "\nnext", takeUntilAny("\n")}},
+        {"line or ;", {string(body.size(), 'x') + ";next", takeUntilAny("\n;")}},
+    };
+    const Parser naive[] = {
+        many(sequence({notFollowedBy(parseString("*/")), anyChar()})),
+        many(sequence({notFollowedBy(parseChar('\n')), anyChar()})),
+        many(sequence({notFollowedBy(anyOf("\n;")), anyChar()})),
+    };
+
+    for (size_t i = 0; i < size(cases); i++) {
+        auto& input = cases[i].second.first;
+        string_view fastRest, naiveRest;
+        auto fast = microsecondsFor(cases[i].second.second, input, fastRest);
+        auto slow = microsecondsFor(naive[i], input, naiveRest);
+
+        if (fastRest.data() != naiveRest.data()) {
+            cerr << cases[i].first << ": scans stopped at different places\n";
+            return 1;
+        }
+        printf("%-14s %8zu bytes   scan %9.1f us   byte by byte %11.1f us\n",
+               cases[i].first, input.size() - fastRest.size(), fast, slow);
+    }
+}
@@ -0,0 +1,133 @@
+// Checks and measures publishing parse results through shared memory with
+// shared_ast.h.
+//
+//     bench_shared_ast [copies] [repeat]
+//
+// Publishes the parse of the sample program repeated `copies` times, and a
+// child process maps it through /proc/<pid>/fd and must read back the same
+// tree. Mapping must fail for a file that is not sealed and for sealed
+// copies with a corrupt header, node link or text offset. Then reports the
+// time to parse, to publish and to map and walk the published tree.
+
+#include "bench_timing.h"
+#include "grammar.h"
+#include "sample.h"
+#include "shared_ast.h"
+
+#include <algorithm>
+
+#include <sys/wait.h>
+
+// Walks `index` and its subtree against `item`; returns whether they match.
+bool sameTree(const SharedAstView& view, uint32_t index, const ResultItem& item) {
+    auto& node = view.node(index);
+    if (view.name(index) != item.name || bool(node.isLeaf) != (item.value.index() == 0)) {
+        return false;
+    }
+    if (node.isLeaf) {
+        return view.value(index) == std::get<0>(item.value);
+    }
+    auto child = node.firstChild;
+    for (auto& childItem : std::get<1>(item.value)) {
+        if (child == sharedAstNone || view.node(child).parent != index || !sameTree(view, child, childItem)) {
+            return false;
+        }
+        child = view.node(child).nextSibling;
+    }
+    return child == sharedAstNone;
+}
+
+bool sameTree(const SharedAstView& view, const ResultMap& results) {
+    return view.valid() && sameTree(view, view.root(), ResultItem {"", results});
+}
+
+// The bytes of the file behind `fd`.
+string contents(int fd) {
+    struct stat info;
+    fstat(fd, &info);
+    string bytes(info.st_size, '\0');
+    pread(fd, bytes.data(), bytes.size(), 0);
+    return bytes;
+}
+
+// A new memfd holding `bytes`, sealed when `seal` is set.
+int fileWith(const string& bytes, bool seal) {
+    int fd = memfd_create("bench-shared-ast", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (pwrite(fd, bytes.data(), bytes.size(), 0) != ssize_t(bytes.size())) {
+        return -1;
+    }
+    if (seal) {
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    }
+    return fd;
+}
+
+bool rejects(const string& label, const string& bytes, bool seal) {
+    int fd = fileWith(bytes, seal);
+    SharedAstView view(fd);
+    close(fd);
+    if (view.valid()) {
+        cerr << "Mapped " << label << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int copies = argc > 1 ? stoi(argv[1]) : 64;
+    int repeat = argc > 2 ? stoi(argv[2]) : 20;
+
+    string source;
+    for (int i = 0; i < copies; i++) {
+        source += sampleSource;
+    }
+    auto results = parse(source).results;
+    int fd = publishSharedAst(results);
+    if (fd < 0) {
+        cerr << "Cannot publish\n";
+        return 1;
+    }
+
+    auto parent = getpid();
+    auto child = fork();
+    if (child == 0) {
+        _exit(sameTree(SharedAstView::open(parent, fd), results) ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cerr << "Another process read a different tree\n";
+        return 1;
+    }
+
+    auto bytes = contents(fd);
+    auto& header = *reinterpret_cast<const SharedAstHeader*>(bytes.data());
+    auto nodeAt = [&](string& copy, uint32_t index) {
+        return reinterpret_cast<SharedAstNode*>(&copy[header.nodesOffset]) + index;
+    };
+    auto count = header.nodeCount;
+    auto badCount = bytes, badLink = bytes, badCycle = bytes, badText = bytes;
+    reinterpret_cast<SharedAstHeader*>(&badCount[0])->nodeCount = UINT32_MAX / 2;
+    nodeAt(badLink, count / 2)->nextSibling = count + 10;
+    nodeAt(badCycle, count / 2)->firstChild = 0;
+    nodeAt(badText, count - 1)->valueOffset = header.textSize;
+    nodeAt(badText, count - 1)->valueLength = 1;
+    if (!rejects("an unsealed file", bytes, false) || !rejects("a wrong node count", badCount, true) ||
+        !rejects("a link past the last node", badLink, true) || !rejects("a link back to the root", badCycle, true) ||
+        !rejects("a value past the text", badText, true)) {
+        return 1;
+    }
+    int copy = fileWith(bytes, true);
+    if (!sameTree(SharedAstView(copy), results)) {
+        cerr << "A sealed copy of a valid file did not map\n";
+        return 1;
+    }
+    close(copy);
+    cout << count << " nodes, " << bytes.size() << " bytes, read by another process; corrupt files rejected\n";
+
+    auto parseUs = medianMicroseconds(max(1, repeat / 10), [&]() { parse(source); });
+    auto publishUs = medianMicroseconds(repeat, [&]() { close(publishSharedAst(results)); });
+    auto readUs = medianMicroseconds(repeat, [&]() { sameTree(SharedAstView(fd), results); });
+    cout << "parse " << parseUs << " us, publish " << publishUs << " us, map and walk " << readUs << " us\n";
+    close(fd);
+}
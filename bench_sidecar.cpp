@@ -0,0 +1,95 @@
+// Checks and measures the declaration sidecar index of sidecar.h.
+//
+//     bench_sidecar [copies] [repeat]
+//
+// Indexes the sample program repeated `copies` times, saves and reloads
+// the index, and parses single declarations through it: the last function
+// and each struct by name must parse to the declaration they were asked
+// for. Loading must fail for a truncated file and for an entry count
+// larger than the file, and parseDeclaration() must fail for another
+// source and for an entry outside the source. Then reports the time of a
+// full parse against that of parsing one declaration through the index.
+
+#include "bench_timing.h"
+#include "sample.h"
+#include "sidecar.h"
+
+#include <algorithm>
+
+// The "name" child of the declaration a result holds.
+string declaredName(const Result& result) {
+    if (result.isSuccess() && !result.results.empty() && result.results.back().value.index() == 1) {
+        for (auto& item : std::get<1>(result.results.back().value)) {
+            if (item.name == "name" && item.value.index() == 0) {
+                return std::get<0>(item.value);
+            }
+        }
+    }
+    return "";
+}
+
+bool loadFails(const string& label, const string& bytes) {
+    auto path = "bench_sidecar.corrupt.pdx";
+    ofstream(path, ios::binary) << bytes;
+    DeclarationIndex index;
+    auto loaded = index.load(path);
+    remove(path);
+    if (loaded) {
+        cerr << "Loaded " << label << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t copies = argc > 1 ? stoi(argv[1]) : 64;
+    int repeat = argc > 2 ? stoi(argv[2]) : 20;
+
+    string source;
+    for (size_t i = 0; i < copies; i++) {
+        source += sampleSource;
+    }
+
+    DeclarationIndex built;
+    parseWithSidecar(source, built);
+    auto path = "bench_sidecar.pdx";
+    DeclarationIndex index;
+    if (!built.save(path) || !index.load(path) || index.size() != built.size() || index.size() != 6 * copies) {
+        cerr << "Expected 6 declarations per copy to survive saving and loading\n";
+        return 1;
+    }
+    ifstream saved(path, ios::binary);
+    string bytes((istreambuf_iterator<char>(saved)), istreambuf_iterator<char>());
+    remove(path);
+
+    auto lastFunction = index.nth(DeclarationKind::Function, copies - 1);
+    if (!lastFunction || declaredName(parseDeclaration(source, index, *lastFunction)) != "main") {
+        cerr << "The last function did not parse\n";
+        return 1;
+    }
+    for (auto name : {"Point", "Line", "Triangle"}) {
+        auto entries = index.named(name);
+        if (entries.size() != copies || declaredName(parseDeclaration(source, index, *entries.back())) != name) {
+            cerr << "Struct " << name << " did not parse\n";
+            return 1;
+        }
+    }
+
+    auto hugeCount = bytes;
+    uint64_t count = UINT64_MAX / sizeof(DeclarationEntry);
+    memcpy(&hugeCount[4 + 2 * sizeof(uint64_t)], &count, sizeof(count));
+    auto outside = *lastFunction;
+    outside.offset = source.size() - 2;
+    if (!loadFails("a truncated file", bytes.substr(0, bytes.size() - 1)) ||
+        !loadFails("an entry count larger than the file", hugeCount) ||
+        parseDeclaration(source + " ", index, *lastFunction).isSuccess() ||
+        parseDeclaration(source, index, outside).isSuccess()) {
+        cerr << "Expected corrupt or stale sidecars to be rejected\n";
+        return 1;
+    }
+    cout << index.size() << " declarations, " << bytes.size() << " bytes of sidecar; corrupt ones rejected\n";
+
+    auto parseUs = medianMicroseconds(max(1, repeat / 10), [&]() { parse(source); });
+    auto declarationUs = medianMicroseconds(repeat, [&]() { parseDeclaration(source, index, *lastFunction); });
+    cout << "full parse " << parseUs << " us, last function through the index " << declarationUs << " us\n";
+}
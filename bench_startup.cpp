@@ -0,0 +1,140 @@
+// Cold-start benchmark.
+//
+// Every rule in grammar.h is a global built during static initialisation.
+// This measures how long that takes and how many allocations it makes, the
+// first parse against warm parses, and the time from starting a process to
+// the end of its first parse.
+//
+//     bench_startup [runs]
+//
+// The parent starts `runs` copies of itself with --child. Each child reports
+// its own numbers over a pipe, and the parent adds the spawn-to-first-parse
+// time measured on the shared monotonic clock.
+
+#include "alloc_counter.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+uint64_t monotonicNanoseconds() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Globals in one translation unit are initialised in order of definition, so
+// these two bracket the construction of every rule in grammar.h.
+struct StartupMark {
+    uint64_t time = monotonicNanoseconds();
+    size_t allocations = allocationCount;
+};
+
+StartupMark beforeGrammar;
+
+#include "grammar.h"
+#include "sample.h"
+
+StartupMark afterGrammar;
+
+double median(vector<double> values) {
+    sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+int child() {
+    auto start = monotonicNanoseconds();
+    auto allocations = allocationCount;
+    parse(sampleSource);
+    auto firstParseEnd = monotonicNanoseconds();
+    auto firstParseAllocations = allocationCount - allocations;
+
+    vector<double> warm;
+    for (int i = 0; i < 50; i++) {
+        auto warmStart = monotonicNanoseconds();
+        parse(sampleSource);
+        warm.push_back(double(monotonicNanoseconds() - warmStart));
+    }
+
+    cout << firstParseEnd << " "
+         << (afterGrammar.time - beforeGrammar.time) << " "
+         << (afterGrammar.allocations - beforeGrammar.allocations) << " "
+         << (firstParseEnd - start) << " "
+         << firstParseAllocations << " "
+         << median(warm) << "\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && string(argv[1]) == "--child") {
+        return child();
+    }
+
+    int runs = argc > 1 ? stoi(argv[1]) : 20;
+
+    vector<double> startToParse, construction, firstParse, warmParse;
+    size_t constructionAllocations = 0, firstParseAllocations = 0;
+
+    for (int run = 0; run < runs; run++) {
+        int output[2];
+        if (pipe(output) != 0) {
+            cerr << "pipe failed\n";
+            return 1;
+        }
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, output[0]);
+
+        char childFlag[] = "--child";
+        char* childArgv[] = {argv[0], childFlag, nullptr};
+
+        pid_t pid;
+        auto spawned = monotonicNanoseconds();
+        if (posix_spawn(&pid, argv[0], &actions, nullptr, childArgv, environ) != 0) {
+            cerr << "Cannot start " << argv[0] << "\n";
+            return 1;
+        }
+        posix_spawn_file_actions_destroy(&actions);
+        close(output[1]);
+
+        string text;
+        char buffer[256];
+        ssize_t count;
+        while ((count = read(output[0], buffer, sizeof(buffer))) > 0) {
+            text.append(buffer, count);
+        }
+        close(output[0]);
+        waitpid(pid, nullptr, 0);
+
+        stringstream fields(text);
+        uint64_t firstParseEnd, constructionTime, firstParseTime;
+        double warm;
+        fields >> firstParseEnd >> constructionTime >> constructionAllocations
+               >> firstParseTime >> firstParseAllocations >> warm;
+        if (!fields) {
+            cerr << "Unexpected child output: " << text << "\n";
+            return 1;
+        }
+
+        startToParse.push_back(double(firstParseEnd - spawned));
+        construction.push_back(double(constructionTime));
+        firstParse.push_back(double(firstParseTime));
+        warmParse.push_back(warm);
+    }
+
+    cout << "Runs:                         " << runs << "\n";
+    cout << "Process start to first parse: " << median(startToParse) / 1000.0 << " us (median)\n";
+    cout << "Grammar construction:         " << median(construction) / 1000.0 << " us, "
+         << constructionAllocations << " allocations\n";
+    cout << "First parse:                  " << median(firstParse) / 1000.0 << " us, "
+         << firstParseAllocations << " allocations\n";
+    cout << "Warm parse:                   " << median(warmParse) / 1000.0 << " us (median)\n";
+}
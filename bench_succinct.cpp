@@ -0,0 +1,101 @@
+// Checks and measures the succinct tree of succinct.h.
+//
+//     bench_succinct [copies] [repeat]
+//
+// Encodes the parse of the sample program repeated `copies` times, a chain
+// nested 10000 deep and a node with 100000 children, and walks each
+// against the ResultMap it came from: every node must have the same name,
+// value, parent, children and subtree size, and its preorder id must
+// select it back. Then reports the bits per node and the time to visit
+// every node by first child and next sibling, and to find every parent.
+
+#include "bench_timing.h"
+#include "grammar.h"
+#include "sample.h"
+#include "succinct.h"
+
+// Checks `node` and its subtree against `item`; returns the subtree size.
+size_t check(const SuccinctTree& tree, SuccinctTree::Node node, const ResultItem& item, SuccinctTree::Node parent,
+             bool& ok) {
+    if (tree.name(node) != item.name || tree.parent(node) != parent || tree.nodeAt(tree.id(node)) != node) {
+        ok = false;
+        return 1;
+    }
+    if (item.value.index() == 0) {
+        ok = ok && tree.isLeaf(node) && tree.value(node) == std::get<0>(item.value);
+        return 1;
+    }
+    size_t size = 1;
+    auto child = tree.firstChild(node);
+    for (auto& childItem : std::get<1>(item.value)) {
+        if (child == SuccinctTree::none) {
+            ok = false;
+            return size;
+        }
+        size += check(tree, child, childItem, node, ok);
+        child = tree.nextSibling(child);
+    }
+    ok = ok && child == SuccinctTree::none && tree.subtreeSize(node) == size;
+    return size;
+}
+
+bool check(const string& label, const ResultMap& results) {
+    SuccinctTree tree(results);
+    ResultItem root {"", results};
+    bool ok = true;
+    auto size = check(tree, tree.root(), root, SuccinctTree::none, ok);
+    if (!ok || size != tree.size()) {
+        cerr << label << ": the tree differs from the results\n";
+        return false;
+    }
+    cout << label << ": " << tree.size() << " nodes, " << double(tree.sizeInBits()) / tree.size()
+         << " bits per node\n";
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int copies = argc > 1 ? stoi(argv[1]) : 300;
+    int repeat = argc > 2 ? stoi(argv[2]) : 20;
+
+    string source;
+    for (int i = 0; i < copies; i++) {
+        source += sampleSource;
+    }
+    auto parsed = parse(source).results;
+
+    ResultMap deep {ResultItem::make("leaf", string("x"))};
+    for (int depth = 0; depth < 10000; depth++) {
+        ResultMap outer;
+        outer.push_back(ResultItem::make("node", std::move(deep)));
+        deep = std::move(outer);
+    }
+    ResultMap wide {ResultItem::make("list", ResultMap(100000, ResultItem::make("leaf", string("y"))))};
+
+    if (!check("sample", parsed) || !check("deep", deep) || !check("wide", wide)) {
+        return 1;
+    }
+
+    SuccinctTree tree(parsed);
+    size_t visited = 0;
+    auto walkUs = medianMicroseconds(repeat, [&]() {
+        visited = 0;
+        vector<SuccinctTree::Node> stack {tree.root()};
+        while (!stack.empty()) {
+            auto node = stack.back();
+            stack.pop_back();
+            visited++;
+            for (auto child = tree.firstChild(node); child != SuccinctTree::none; child = tree.nextSibling(child)) {
+                stack.push_back(child);
+            }
+        }
+    });
+    size_t roots = 0;
+    auto parentUs = medianMicroseconds(repeat, [&]() {
+        roots = 0;
+        for (size_t id = 0; id < tree.size(); id++) {
+            roots += tree.parent(tree.nodeAt(id)) == SuccinctTree::none;
+        }
+    });
+    cout << visited << " nodes walked in " << walkUs << " us, " << roots << " root among all parents in "
+         << parentUs << " us\n";
+}
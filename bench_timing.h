@@ -0,0 +1,34 @@
+#pragma once
+
+// Timing helpers shared by the benchmarks.
+
+#include <algorithm>
+#include <chrono>
+#include <ratio>
+#include <vector>
+
+using namespace std;
+
+// Runs `body` `repeat` times and returns the median wall time of one run,
+// in units of `Period` (micro for microseconds, nano for nanoseconds).
+template <typename Period, typename Body>
+double medianTime(int repeat, Body body) {
+    vector<double> times;
+    for (int i = 0; i < repeat; i++) {
+        auto start = chrono::steady_clock::now();
+        body();
+        times.push_back(chrono::duration<double, Period>(chrono::steady_clock::now() - start).count());
+    }
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+template <typename Body>
+double medianMicroseconds(int repeat, Body body) {
+    return medianTime<micro>(repeat, body);
+}
+
+template <typename Body>
+double medianNanoseconds(int repeat, Body body) {
+    return medianTime<nano>(repeat, body);
+}
@@ -0,0 +1,110 @@
+// Checks and measures the parallel cross-reference index of xref.h.
+//
+//     bench_xref [files] [threads]
+//
+// Indexes `files` copies of the sample program, each with its structs
+// renamed apart, with one thread and with `threads`. Both indexes must hold
+// exactly the definitions and references the sample contains: per file,
+// Point, Line and Triangle defined once, five fields of type Point, one
+// parameter of type Line and five uses of int. So must indexes built with
+// every AstShape, set on the calling thread or through shaped(). Reports
+// the time of each build and of a lookup.
+
+#include "grammar.h"
+#include "sample.h"
+#include "xref.h"
+
+#include <algorithm>
+#include <chrono>
+
+void replaceAll(string& text, const string& before, const string& after) {
+    for (auto position = text.find(before); position != string::npos;
+         position = text.find(before, position + after.size())) {
+        text.replace(position, before.size(), after);
+    }
+}
+
+// Whether `index` holds what the sample contributes once per file.
+bool check(const CrossReferenceIndex& index, size_t files) {
+    for (size_t file = 0; file < files; file++) {
+        auto suffix = to_string(file);
+        auto& point = index.referencesTo("Point" + suffix);
+        auto& line = index.referencesTo("Line" + suffix);
+        size_t fields = 0;
+        for (auto& reference : point) {
+            fields += reference.kind == ReferenceKind::Field && reference.file == file;
+        }
+        if (point.size() != 5 || fields != 5 || line.size() != 1 ||
+            line[0].kind != ReferenceKind::Parameter || line[0].owner != "Line" + suffix + ".interesect" ||
+            line[0].member != "other") {
+            cerr << "Wrong references in file " << file << "\n";
+            return false;
+        }
+        for (auto& type : {"Point", "Line", "Triangle"}) {
+            auto& definitions = index.definitionsOf(type + suffix);
+            if (definitions.size() != 1 || definitions[0].file != file) {
+                cerr << "Wrong definition of " << type << suffix << "\n";
+                return false;
+            }
+        }
+    }
+    if (index.referencesTo("int").size() != 5 * files || index.structNames().size() != 3 * files) {
+        cerr << "Wrong int references or struct count\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    size_t fileCount = argc > 1 ? stoi(argv[1]) : 64;
+    unsigned threads = argc > 2 ? stoi(argv[2]) : max(2u, thread::hardware_concurrency());
+
+    vector<string> files;
+    for (size_t file = 0; file < fileCount; file++) {
+        auto source = sampleSource;
+        auto suffix = to_string(file);
+        replaceAll(source, "Point", "Point" + suffix);
+        replaceAll(source, "Line", "Line" + suffix);
+        replaceAll(source, "Triangle", "Triangle" + suffix);
+        files.push_back(source);
+    }
+
+    auto time = [](auto body) {
+        auto start = chrono::steady_clock::now();
+        body();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    unique_ptr<CrossReferenceIndex> serial, parallel;
+    auto serialMs = time([&]() { serial = make_unique<CrossReferenceIndex>(parse, files, 1); });
+    auto parallelMs = time([&]() { parallel = make_unique<CrossReferenceIndex>(parse, files, threads); });
+    if (!check(*serial, fileCount) || !check(*parallel, fileCount)) {
+        return 1;
+    }
+
+    for (auto flatten : {false, true}) {
+        for (auto elide : {false, true}) {
+            AstShape shape;
+            shape.flattenItems = flatten;
+            shape.elideWrappers = elide;
+            astShape = shape;
+            CrossReferenceIndex onThread(parse, files, threads);
+            astShape = AstShape{};
+            CrossReferenceIndex throughParser(shaped(parse, shape), files, threads);
+            if (!check(onThread, fileCount) || !check(throughParser, fileCount)) {
+                cerr << "with flattenItems " << flatten << " and elideWrappers " << elide << "\n";
+                return 1;
+            }
+        }
+    }
+
+    size_t found = 0;
+    const int lookups = 100000;
+    auto lookupMs = time([&]() {
+        for (int i = 0; i < lookups; i++) {
+            found += parallel->referencesTo("Point" + to_string(i % fileCount)).size();
+        }
+    });
+    cout << fileCount << " files, 1 thread " << serialMs << " ms, " << threads << " threads "
+         << parallelMs << " ms, " << lookupMs * 1e6 / lookups << " ns per lookup\n";
+}
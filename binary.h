@@ -0,0 +1,215 @@
+#pragma once
+
+// Byte-level combinators for binary formats.
+//
+// Results already refer to their input through string_views, which hold
+// arbitrary bytes just as well as text, so binary formats can be described
+// with the usual sequence, many and mapTo. The primitives here match
+// fixed-width integers, LEB128 varints and length-prefixed blobs; they
+// produce no named results themselves, so skipping a payload never copies
+// it. decode() and payload() read the value of a match, and onMatch() hands
+// the view of a match to a callback instead of copying it into the AST.
+
+#include "parser.h"
+
+#include <cstdint>
+
+enum class Endian {
+    Little,
+    Big
+};
+
+// How an integer is stored: `width` bytes in `endian` order, or a varint
+// when width is 0.
+struct IntFormat {
+    int width;
+    Endian endian;
+};
+
+const IntFormat u8 {1, Endian::Little};
+const IntFormat u16le {2, Endian::Little};
+const IntFormat u16be {2, Endian::Big};
+const IntFormat u32le {4, Endian::Little};
+const IntFormat u32be {4, Endian::Big};
+const IntFormat u64le {8, Endian::Little};
+const IntFormat u64be {8, Endian::Big};
+const IntFormat varint {0, Endian::Little};
+
+// Length of the integer at the start of `source`, or 0 when it is cut off
+// or an over-long varint.
+size_t integerLength(IntFormat format, string_view source) {
+    if (format.width > 0) {
+        return source.size() >= size_t(format.width) ? format.width : 0;
+    }
+    for (size_t i = 0; i < source.size() && i < 10; i++) {
+        if ((source[i] & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Value of an integer matched by binaryInteger(format).
+uint64_t decode(IntFormat format, string_view bytes) {
+    uint64_t value = 0;
+    if (format.width == 0) {
+        for (size_t i = 0; i < bytes.size(); i++) {
+            value |= uint64_t(bytes[i] & 0x7f) << (7 * i);
+        }
+    } else if (format.endian == Endian::Little) {
+        for (size_t i = bytes.size(); i-- > 0;) {
+            value = (value << 8) | uint8_t(bytes[i]);
+        }
+    } else {
+        for (auto byte : bytes) {
+            value = (value << 8) | uint8_t(byte);
+        }
+    }
+    return value;
+}
+
+// Records that a parser hit the end of `source` when an integer at its
+// start could not be read. Over-long varints fail without reaching it.
+void noteTruncated(IntFormat format, string_view source) {
+    if (format.width > 0 || source.size() < 10) {
+        sawEndOfInput = true;
+    }
+}
+
+Parser binaryInteger(IntFormat format) {
+    return [format](string_view source) -> Result {
+        combinatorSteps++;
+        auto length = integerLength(format, source);
+        if (length == 0) {
+            noteTruncated(format, source);
+            return Result::failure("Truncated integer");
+        }
+        return Result::success(source.substr(0, length), source.substr(length));
+    };
+}
+
+// An integer equal to `expected`, for magic numbers and tags.
+Parser binaryConstant(IntFormat format, uint64_t expected) {
+    return [format, expected](string_view source) -> Result {
+        combinatorSteps++;
+        auto length = integerLength(format, source);
+        if (length == 0) {
+            noteTruncated(format, source);
+        }
+        if (length == 0 || decode(format, source.substr(0, length)) != expected) {
+            stringstream error;
+            error << "Expected " << expected;
+            return Result::failure(error.str());
+        }
+        return Result::success(source.substr(0, length), source.substr(length));
+    };
+}
+
+// Exactly `size` bytes.
+Parser bytes(size_t size) {
+    return [size](string_view source) -> Result {
+        combinatorSteps++;
+        if (source.size() < size) {
+            sawEndOfInput = true;
+            return Result::failure("End of imput stream.");
+        }
+        return Result::success(source.substr(0, size), source.substr(size));
+    };
+}
+
+// A length in `lengthFormat` followed by that many bytes. The match covers
+// both; payload() gives the bytes.
+Parser blob(IntFormat lengthFormat) {
+    return [lengthFormat](string_view source) -> Result {
+        combinatorSteps++;
+        auto prefix = integerLength(lengthFormat, source);
+        if (prefix == 0) {
+            noteTruncated(lengthFormat, source);
+            return Result::failure("Truncated length");
+        }
+        auto size = decode(lengthFormat, source.substr(0, prefix));
+        if (size > source.size() - prefix) {
+            sawEndOfInput = true;
+            return Result::failure("Truncated blob");
+        }
+        auto length = prefix + size;
+        return Result::success(source.substr(0, length), source.substr(length));
+    };
+}
+
+// The bytes of a blob(lengthFormat) match, without its length.
+string_view payload(IntFormat lengthFormat, string_view matched) {
+    return matched.substr(integerLength(lengthFormat, matched));
+}
+
+// `n` matches of `parser` from `source`, with results wrapped like many's.
+// A match that consumes nothing ends the loop: the rest would match the
+// same input again, and `n` may come from the input itself, so they are
+// not repeated up to 2^64 times.
+Result matchTimes(size_t n, const Parser& parser, string_view source) {
+    string_view input = source;
+    ResultMap items;
+
+    for (size_t i = 0; i < n; i++) {
+        auto result = parser(input);
+        if (result.isFailure()) {
+            return result;
+        }
+        auto empty = result.rest.size() == input.size();
+        input = result.rest;
+        if (result.results.size() == 1 && astShape.flattenItems) {
+            items.push_back(std::move(result.results[0]));
+        } else if (result.results.size() > 0) {
+            items.push_back(ResultItem::make("item", std::move(result.results)));
+        }
+        if (empty) {
+            break;
+        }
+    }
+
+    auto result = Result::success(consumed(source, input), input);
+    result.results = std::move(items);
+    return result;
+}
+
+// Exactly `n` matches of `parser`.
+Parser count(size_t n, Parser parser) {
+    return [n, parser](string_view source) -> Result {
+        combinatorSteps++;
+        return matchTimes(n, parser, source);
+    };
+}
+
+// A count in `countFormat` followed by that many matches of `parser`.
+Parser counted(IntFormat countFormat, Parser parser) {
+    return [countFormat, parser](string_view source) -> Result {
+        combinatorSteps++;
+        auto length = integerLength(countFormat, source);
+        if (length == 0) {
+            noteTruncated(countFormat, source);
+            return Result::failure("Truncated count");
+        }
+        auto items = matchTimes(decode(countFormat, source.substr(0, length)), parser, source.substr(length));
+        if (items.isFailure()) {
+            return items;
+        }
+        items.matched = consumed(source, items.rest);
+        return items;
+    };
+}
+
+// Calls `callback` with the match of `parser` when it succeeds. The view
+// points into the input, so nothing is copied. The callback runs as soon as
+// `parser` succeeds, also inside an alternative or sequence that later
+// fails and is backtracked out of, so wrap it around records that are kept
+// once matched, or make it tolerate matches that are then abandoned.
+Parser onMatch(Parser parser, std::function<void(string_view)> callback) {
+    return [parser, callback](string_view source) -> Result {
+        combinatorSteps++;
+        auto result = parser(source);
+        if (result.isSuccess()) {
+            callback(result.matched);
+        }
+        return result;
+    };
+}
@@ -0,0 +1,348 @@
+#pragma once
+
+// Bytecode for the expressions of parsed `if` conditions.
+//
+// An expression parsed by `expression` is a tree of MulExpression,
+// AddExpression and EqualityExpression nodes, each a `left` operand
+// followed by `item`s of `operator` and `right`. Evaluating it by walking
+// that tree means string compares and map lookups at every node, so
+// compileExpression() turns it into register bytecode once: integer
+// literals and names declared with `const` are folded into constants, every
+// other name becomes an input slot, and each remaining operation is one
+// instruction writing a fresh register.
+//
+// evaluateBatch() then runs a program over many bindings at a time. The
+// bindings are given per variable as a column, and each instruction is
+// applied to a whole block of rows before the next, so dispatch is paid
+// once per block and the inner loops are plain array arithmetic. Loading a
+// variable just points its register at the column.
+//
+// Arithmetic is 64-bit and wraps on overflow; division by zero gives 0, and
+// == and != give 1 or 0.
+
+#include "parser.h"
+
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+enum class OpCode : uint8_t {
+    Constant,
+    Variable,
+    Multiply,
+    Divide,
+    Add,
+    Subtract,
+    Equal,
+    NotEqual
+};
+
+struct Instruction {
+    OpCode op;
+    // Operand registers, or the variable slot for Variable.
+    uint16_t left;
+    uint16_t right;
+    // Value for Constant.
+    int64_t value;
+};
+
+// Instruction i writes register i; the last one holds the result.
+struct ExpressionProgram {
+    vector<Instruction> code;
+    vector<string> variables;
+    string error;
+
+    bool valid() const { return error.empty() && !code.empty(); }
+};
+
+using Constants = unordered_map<string, int64_t>;
+
+namespace bytecode {
+
+int64_t apply(OpCode op, int64_t left, int64_t right) {
+    auto a = uint64_t(left), b = uint64_t(right);
+    switch (op) {
+        case OpCode::Multiply: return int64_t(a * b);
+        case OpCode::Add: return int64_t(a + b);
+        case OpCode::Subtract: return int64_t(a - b);
+        case OpCode::Divide:
+            if (right == 0) {
+                return 0;
+            }
+            if (right == -1) {
+                return int64_t(0 - a);
+            }
+            return left / right;
+        case OpCode::Equal: return left == right;
+        case OpCode::NotEqual: return left != right;
+        default: return 0;
+    }
+}
+
+OpCode binaryOp(const string& op) {
+    if (op == "*") return OpCode::Multiply;
+    if (op == "/") return OpCode::Divide;
+    if (op == "+") return OpCode::Add;
+    if (op == "-") return OpCode::Subtract;
+    if (op == "==") return OpCode::Equal;
+    if (op == "!=") return OpCode::NotEqual;
+    return OpCode::Constant;
+}
+
+bool isExpressionNode(const string& name) {
+    return name == "MulExpression" || name == "AddExpression" || name == "EqualityExpression";
+}
+
+class Compiler {
+public:
+    Compiler(const Constants& constants, ExpressionProgram& program):
+        constants(constants),
+        program(program) {
+    }
+
+    // An operand is either a constant or a register holding its value.
+    struct Operand {
+        bool constant;
+        int64_t value;
+        uint16_t reg;
+    };
+
+    // `node` is an expression node, or an operand (`condition`, `left`,
+    // `right`) wrapping one or holding a literal or name.
+    Operand compile(const ResultItem& node) {
+        if (node.value.index() == 0) {
+            return leaf(std::get<0>(node.value));
+        }
+
+        auto& children = std::get<1>(node.value);
+        if (!isExpressionNode(node.name)) {
+            if (children.size() != 1) {
+                return fail("Expected one expression in " + node.name);
+            }
+            return compile(children[0]);
+        }
+
+        if (children.empty() || children[0].name != "left") {
+            return fail("Expected left operand in " + node.name);
+        }
+
+        auto result = compile(children[0]);
+        for (size_t i = 1; i < children.size() && program.error.empty(); i++) {
+            auto& item = children[i];
+            if (item.value.index() != 1 || std::get<1>(item.value).size() != 2) {
+                return fail("Expected operator and right operand in " + node.name);
+            }
+
+            auto& parts = std::get<1>(item.value);
+            if (parts[0].value.index() != 0 || binaryOp(std::get<0>(parts[0].value)) == OpCode::Constant) {
+                return fail("Unknown operator in " + node.name);
+            }
+            auto op = binaryOp(std::get<0>(parts[0].value));
+            result = combine(op, result, compile(parts[1]));
+        }
+        return result;
+    }
+
+    uint16_t materialise(Operand operand) {
+        if (!operand.constant) {
+            return operand.reg;
+        }
+        return emit(Instruction{OpCode::Constant, 0, 0, operand.value});
+    }
+
+private:
+    Operand leaf(const string& text) {
+        if (!text.empty() && isdigit((unsigned char)text[0])) {
+            int64_t value;
+            auto end = text.data() + text.size();
+            auto parsed = from_chars(text.data(), end, value);
+            if (parsed.ec != errc() || parsed.ptr != end) {
+                return fail("Integer literal out of range: " + text);
+            }
+            return Operand{true, value, 0};
+        }
+
+        auto constant = constants.find(text);
+        if (constant != constants.end()) {
+            return Operand{true, constant->second, 0};
+        }
+
+        auto slot = variableSlots.find(text);
+        if (slot == variableSlots.end()) {
+            if (program.variables.size() > numeric_limits<uint16_t>::max()) {
+                return fail("Too many variables: slots are 16-bit");
+            }
+            slot = variableSlots.emplace(text, uint16_t(program.variables.size())).first;
+            program.variables.push_back(text);
+        }
+        return Operand{false, 0, emit(Instruction{OpCode::Variable, slot->second, 0, 0})};
+    }
+
+    Operand combine(OpCode op, Operand left, Operand right) {
+        if (left.constant && right.constant) {
+            return Operand{true, apply(op, left.value, right.value), 0};
+        }
+        auto leftRegister = materialise(left);
+        auto rightRegister = materialise(right);
+        return Operand{false, 0, emit(Instruction{op, leftRegister, rightRegister, 0})};
+    }
+
+    // Registers are numbered by instruction, so a program holds at most
+    // 65,536 of them; past that the expression is rejected.
+    uint16_t emit(Instruction instruction) {
+        if (program.code.size() > numeric_limits<uint16_t>::max()) {
+            fail("Expression too large: registers are 16-bit");
+            return 0;
+        }
+        program.code.push_back(instruction);
+        return uint16_t(program.code.size() - 1);
+    }
+
+    Operand fail(string error) {
+        if (program.error.empty()) {
+            program.error = std::move(error);
+        }
+        return Operand{true, 0, 0};
+    }
+
+    const Constants& constants;
+    ExpressionProgram& program;
+    unordered_map<string, uint16_t> variableSlots;
+};
+
+}
+
+// Compiles an expression node, or a `condition` holding one.
+ExpressionProgram compileExpression(const ResultItem& node, const Constants& constants = {}) {
+    ExpressionProgram program;
+    bytecode::Compiler compiler(constants, program);
+    auto result = compiler.compile(node);
+
+    // A folded expression needs one instruction to hold its value.
+    if (program.error.empty() && result.constant) {
+        compiler.materialise(result);
+    }
+    if (!program.error.empty()) {
+        program.code.clear();
+    }
+    return program;
+}
+
+// Values of the top-level `const` declarations of a parse. Declarations
+// sit in the `item` wrappers of `many` under the root.
+Constants constantsOf(const ResultMap& ast) {
+    Constants constants;
+    for (auto& root : ast) {
+        if (root.value.index() != 1) {
+            continue;
+        }
+        for (auto& item : std::get<1>(root.value)) {
+            auto declaration = &unwrapped(item);
+            if (declaration->name != "const" || declaration->value.index() != 1) {
+                continue;
+            }
+
+            string name, value;
+            for (auto& field : std::get<1>(declaration->value)) {
+                if (field.value.index() == 0 && field.name == "name") {
+                    name = std::get<0>(field.value);
+                } else if (field.value.index() == 0 && field.name == "value") {
+                    value = std::get<0>(field.value);
+                }
+            }
+
+            int64_t number;
+            auto end = value.data() + value.size();
+            auto parsed = from_chars(value.data(), end, number);
+            if (!name.empty() && parsed.ec == errc() && parsed.ptr == end) {
+                constants[name] = number;
+            }
+        }
+    }
+    return constants;
+}
+
+// Every `condition` node in a parse, in document order.
+vector<const ResultItem*> conditionsOf(const ResultMap& items) {
+    vector<const ResultItem*> conditions;
+    std::function<void(const ResultMap&)> visit = [&](const ResultMap& children) {
+        for (auto& child : children) {
+            if (child.name == "condition") {
+                conditions.push_back(&child);
+            } else if (child.value.index() == 1) {
+                visit(std::get<1>(child.value));
+            }
+        }
+    };
+    visit(items);
+    return conditions;
+}
+
+// Evaluates a valid `program` for one binding; `variables` holds a value
+// for each of program.variables.
+int64_t evaluate(const ExpressionProgram& program, const int64_t* variables) {
+    thread_local vector<int64_t> registers;
+    registers.resize(program.code.size());
+    for (size_t i = 0; i < program.code.size(); i++) {
+        auto& instruction = program.code[i];
+        switch (instruction.op) {
+            case OpCode::Constant: registers[i] = instruction.value; break;
+            case OpCode::Variable: registers[i] = variables[instruction.left]; break;
+            default: registers[i] = bytecode::apply(instruction.op, registers[instruction.left], registers[instruction.right]);
+        }
+    }
+    return registers[program.code.size() - 1];
+}
+
+// Evaluates a valid `program` for `rows` bindings. columns[v][row] is the value of
+// program.variables[v] in that row; results[row] receives the value.
+void evaluateBatch(const ExpressionProgram& program, const int64_t* const* columns, size_t rows, int64_t* results) {
+    const size_t block = 256;
+    auto count = program.code.size();
+    vector<int64_t> scratch(count * block);
+    vector<const int64_t*> registers(count);
+
+    for (size_t start = 0; start < rows; start += block) {
+        auto n = min(block, rows - start);
+
+        for (size_t i = 0; i < count; i++) {
+            auto& instruction = program.code[i];
+            auto out = &scratch[i * block];
+
+            if (instruction.op == OpCode::Variable) {
+                registers[i] = columns[instruction.left] + start;
+                continue;
+            }
+            registers[i] = out;
+            if (instruction.op == OpCode::Constant) {
+                fill(out, out + n, instruction.value);
+                continue;
+            }
+
+            auto a = registers[instruction.left], b = registers[instruction.right];
+            switch (instruction.op) {
+                case OpCode::Multiply:
+                    for (size_t row = 0; row < n; row++) out[row] = int64_t(uint64_t(a[row]) * uint64_t(b[row]));
+                    break;
+                case OpCode::Add:
+                    for (size_t row = 0; row < n; row++) out[row] = int64_t(uint64_t(a[row]) + uint64_t(b[row]));
+                    break;
+                case OpCode::Subtract:
+                    for (size_t row = 0; row < n; row++) out[row] = int64_t(uint64_t(a[row]) - uint64_t(b[row]));
+                    break;
+                case OpCode::Equal:
+                    for (size_t row = 0; row < n; row++) out[row] = a[row] == b[row];
+                    break;
+                case OpCode::NotEqual:
+                    for (size_t row = 0; row < n; row++) out[row] = a[row] != b[row];
+                    break;
+                default:
+                    for (size_t row = 0; row < n; row++) out[row] = bytecode::apply(instruction.op, a[row], b[row]);
+            }
+        }
+
+        copy(registers[count - 1], registers[count - 1] + n, results + start);
+    }
+}
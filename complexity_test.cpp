@@ -0,0 +1,112 @@
+// Asymptotic complexity regression tests.
+//
+// Each grammar shape is parsed at sizes N, 2N, 4N and 8N. Combinator steps,
+// heap allocations and allocated bytes must roughly double with the input,
+// so reintroducing per-step copies of the input (substr, matched + ...) or of
+// AST subtrees fails here no matter how fast the machine is.
+
+#include "alloc_counter.h"
+#include "grammar.h"
+
+struct Cost {
+    size_t steps;
+    size_t allocations;
+    size_t bytes;
+};
+
+struct Shape {
+    string name;
+    std::function<string(size_t)> generate;
+};
+
+string repeat(const string& text, size_t count) {
+    string result;
+    for (size_t i = 0; i < count; i++) {
+        result += text;
+    }
+    return result;
+}
+
+const vector<Shape> shapes = {
+    {"many list", [](size_t n) {
+        return repeat("const x = 100\n", n);
+    }},
+    {"nested if", [](size_t n) {
+        return "function f () {" + repeat(" if a {", n) + repeat(" }", n) + " }";
+    }},
+    {"binary expression", [](size_t n) {
+        return "function f () { if a" + repeat(" + b * 2", n) + " == 1 { } }";
+    }},
+    {"parameter list", [](size_t n) {
+        string parameters = "int a";
+        for (size_t i = 1; i < n; i++) {
+            parameters += ", int a" + to_string(i);
+        }
+        return "function f (" + parameters + ") { }";
+    }},
+};
+
+bool onlyWhiteSpace(string_view text) {
+    return text.find_first_not_of(" \t\r\n") == string_view::npos;
+}
+
+Cost measure(const string& source, bool& complete) {
+    combinatorSteps = 0;
+    allocationCount = 0;
+    allocationBytes = 0;
+
+    auto result = parse(source);
+
+    Cost cost{combinatorSteps, allocationCount, allocationBytes};
+    complete = result.isSuccess() && onlyWhiteSpace(result.rest);
+    return cost;
+}
+
+// Going from n to 2n may cost at most this much more than twice as much.
+const double maxGrowth = 2.2;
+
+int main() {
+    const size_t sizes[] = {32, 64, 128, 256};
+    int failures = 0;
+
+    for (auto& shape : shapes) {
+        vector<Cost> costs;
+
+        for (auto size : sizes) {
+            bool complete = false;
+            costs.push_back(measure(shape.generate(size), complete));
+
+            if (!complete) {
+                cout << "FAIL " << shape.name << ": input of size " << size << " was not fully parsed\n";
+                failures++;
+            }
+        }
+
+        auto check = [&](const string& metric, size_t Cost::*field) {
+            for (size_t i = 1; i < costs.size(); i++) {
+                auto growth = double(costs[i].*field) / double(costs[i - 1].*field);
+                if (growth > maxGrowth) {
+                    cout << "FAIL " << shape.name << ": " << metric << " grew " << growth << "x from N="
+                         << sizes[i - 1] << " (" << costs[i - 1].*field << ") to N=" << sizes[i]
+                         << " (" << costs[i].*field << ")\n";
+                    failures++;
+                }
+            }
+        };
+
+        check("steps", &Cost::steps);
+        check("allocations", &Cost::allocations);
+        check("allocated bytes", &Cost::bytes);
+
+        auto& last = costs.back();
+        cout << shape.name << ": " << last.steps << " steps, " << last.allocations << " allocations, "
+             << last.bytes << " bytes at N=" << sizes[3] << "\n";
+    }
+
+    if (failures > 0) {
+        cout << failures << " complexity check(s) failed\n";
+        return 1;
+    }
+    cout << "All complexity checks passed\n";
+    return 0;
+}
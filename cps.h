@@ -0,0 +1,402 @@
+#pragma once
+
+// Continuation-passing combinator engine.
+//
+// The engine in parser.h returns a Result by value from every combinator,
+// and its callers inspect it and move parts of it into the next one. Here a
+// parser is instead a small function object
+//
+//     parser(context, position, onSuccess, onFailure)
+//
+// that calls onSuccess(newPosition) or onFailure() and returns nothing. The
+// position is a plain pointer, named results are appended to one vector in
+// the Context and cut back to a mark when an alternative fails, and the
+// message for a failure is only formatted when the whole parse fails. All
+// combinators are templates, so a grammar built from them is a single type
+// the compiler can inline through; Rule erases the type where a grammar has
+// to refer to itself.
+//
+// Semantics are those of parser.h: ordered choice commits to the first
+// alternative that succeeds, many is greedy, many1 drops the results of its
+// items, and named wraps what its parser produced just like mapTo, in the
+// shape astShape asks for. run() returns the same Result the interpreted
+// grammar would, including the error. Rule observers are not notified.
+
+#include "parser.h"
+
+#include <bitset>
+#include <iterator>
+#include <type_traits>
+
+namespace cps {
+
+struct Context {
+    string_view input;
+    ResultMap results;
+    size_t steps = 0;
+
+    // The most recent failed character test.
+    const char* failedAt = nullptr;
+    char expected = 0;
+
+    const char* end() const { return input.data() + input.size(); }
+
+    void failed(const char* position, char ch) {
+        failedAt = position;
+        expected = ch;
+    }
+
+    // The message parser.h produces for the same failure.
+    string error() const {
+        if (failedAt == end()) {
+            return "End of imput stream.";
+        }
+        stringstream error;
+        error << "Expected '" << expected << "' but got '" << *failedAt << "'";
+        return error.str();
+    }
+
+    // Names the results produced since `mark` like nameResult() does,
+    // following astShape.
+    void name(size_t mark, const string& name) {
+        if (results.size() == mark + 1) {
+            if (astShape.flattenItems && name == "item") {
+                return;
+            }
+            if (astShape.elideWrappers && results.back().value.index() == 0) {
+                results.back() = ResultItem::make(name, std::move(std::get<0>(results.back().value)));
+                return;
+            }
+        }
+        wrap(mark, name);
+    }
+
+    // Moves the results produced since `mark` into one item.
+    void wrap(size_t mark, string name) {
+        ResultMap children(make_move_iterator(results.begin() + mark), make_move_iterator(results.end()));
+        results.erase(results.begin() + mark, results.end());
+        results.push_back(ResultItem::make(std::move(name), std::move(children)));
+    }
+};
+
+// A non-owning reference to a callable, used where a Rule erases the types
+// of its continuations.
+template <typename Signature>
+class FunctionRef;
+
+template <typename R, typename... Args>
+class FunctionRef<R(Args...)> {
+public:
+    template <typename F, typename = enable_if_t<!is_same_v<decay_t<F>, FunctionRef>>>
+    FunctionRef(F&& function):
+        object(const_cast<void*>(static_cast<const void*>(&function))),
+        call([](void* object, Args... args) -> R {
+            return (*static_cast<remove_reference_t<F>*>(object))(std::forward<Args>(args)...);
+        }) {
+    }
+
+    R operator()(Args... args) const {
+        return call(object, std::forward<Args>(args)...);
+    }
+
+private:
+    void* object;
+    R (*call)(void*, Args...);
+};
+
+using Success = FunctionRef<void(const char*)>;
+using Failure = FunctionRef<void()>;
+
+struct Char {
+    char ch;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        if (position != ctx.end() && *position == ch) {
+            ok(position + 1);
+        } else {
+            ctx.failed(position, ch);
+            fail();
+        }
+    }
+};
+
+// One character out of a set. On failure it reports the last character of
+// the set, as a choice of parseChar would.
+struct CharSet {
+    bitset<256> chars;
+    char last;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        if (position != ctx.end() && chars[(unsigned char)*position]) {
+            ok(position + 1);
+        } else {
+            ctx.failed(position, last);
+            fail();
+        }
+    }
+};
+
+struct Literal {
+    string text;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        for (auto ch : text) {
+            if (position == ctx.end() || *position != ch) {
+                ctx.failed(position, ch);
+                fail();
+                return;
+            }
+            position++;
+        }
+        ok(position);
+    }
+};
+
+template <typename A, typename B>
+struct Sequence {
+    A first;
+    B second;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        first(ctx, position, [&](const char* next) {
+            second(ctx, next, ok, fail);
+        }, fail);
+    }
+};
+
+template <typename A, typename B>
+struct Choice {
+    A first;
+    B second;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        auto mark = ctx.results.size();
+        first(ctx, position, ok, [&]() {
+            ctx.results.erase(ctx.results.begin() + mark, ctx.results.end());
+            second(ctx, position, ok, fail);
+        });
+    }
+};
+
+struct Empty {
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&&) const {
+        ctx.steps++;
+        ok(position);
+    }
+};
+
+template <typename P>
+struct Many {
+    P parser;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&&) const {
+        ctx.steps++;
+        while (true) {
+            auto mark = ctx.results.size();
+            const char* next = nullptr;
+            parser(ctx, position, [&](const char* end) { next = end; }, []() {});
+
+            if (next == nullptr) {
+                ctx.results.erase(ctx.results.begin() + mark, ctx.results.end());
+                break;
+            }
+            if (ctx.results.size() > mark + 1 || (ctx.results.size() == mark + 1 && !astShape.flattenItems)) {
+                ctx.wrap(mark, "item");
+            }
+            position = next;
+        }
+        ok(position);
+    }
+};
+
+template <typename P>
+struct Many1 {
+    P parser;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        auto mark = ctx.results.size();
+        auto start = position;
+        while (true) {
+            const char* next = nullptr;
+            parser(ctx, position, [&](const char* end) { next = end; }, []() {});
+            if (next == nullptr) {
+                break;
+            }
+            position = next;
+        }
+
+        ctx.results.erase(ctx.results.begin() + mark, ctx.results.end());
+        if (position == start) {
+            fail();
+        } else {
+            ok(position);
+        }
+    }
+};
+
+template <typename P>
+struct Named {
+    P parser;
+    string name;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        auto mark = ctx.results.size();
+        parser(ctx, position, [&](const char* end) {
+            if (ctx.results.size() > mark) {
+                ctx.name(mark, name);
+            } else if (end != position) {
+                ctx.results.push_back(ResultItem::make(name, string(position, end)));
+            }
+            ok(end);
+        }, fail);
+    }
+};
+
+// A type-erased parser, for rules that refer to themselves. Other parsers
+// hold it through ref(), so it can be referenced before it is defined.
+class Rule {
+public:
+    Rule() {}
+
+    template <typename P, typename = enable_if_t<!is_same_v<decay_t<P>, Rule>>>
+    Rule(P parser):
+        body([parser](Context& ctx, const char* position, Success ok, Failure fail) {
+            parser(ctx, position, ok, fail);
+        }) {
+    }
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        body(ctx, position, Success(ok), Failure(fail));
+    }
+
+private:
+    std::function<void(Context&, const char*, Success, Failure)> body;
+};
+
+struct RuleRef {
+    const Rule* rule;
+
+    template <typename Ok, typename Fail>
+    void operator()(Context& ctx, const char* position, Ok&& ok, Fail&& fail) const {
+        ctx.steps++;
+        (*rule)(ctx, position, ok, fail);
+    }
+};
+
+Char character(char ch) {
+    return Char{ch};
+}
+
+CharSet oneOf(string_view chars) {
+    CharSet set{{}, chars.back()};
+    for (unsigned char ch : chars) {
+        set.chars.set(ch);
+    }
+    return set;
+}
+
+CharSet range(char start, char end) {
+    CharSet set{{}, end};
+    for (int ch = (unsigned char)start; ch <= (unsigned char)end; ch++) {
+        set.chars.set(ch);
+    }
+    return set;
+}
+
+CharSet operator|(CharSet a, const CharSet& b) {
+    a.chars |= b.chars;
+    a.last = b.last;
+    return a;
+}
+
+Literal literal(string text) {
+    return Literal{std::move(text)};
+}
+
+template <typename A>
+A sequence(A a) {
+    return a;
+}
+
+template <typename A, typename B, typename... Rest>
+auto sequence(A a, B b, Rest... rest) {
+    return Sequence<A, decltype(sequence(b, rest...))>{a, sequence(b, rest...)};
+}
+
+template <typename A>
+A choice(A a) {
+    return a;
+}
+
+template <typename A, typename B, typename... Rest>
+auto choice(A a, B b, Rest... rest) {
+    return Choice<A, decltype(choice(b, rest...))>{a, choice(b, rest...)};
+}
+
+template <typename P>
+auto opt(P parser) {
+    return choice(parser, Empty{});
+}
+
+template <typename P>
+Many<P> many(P parser) {
+    return Many<P>{parser};
+}
+
+template <typename P>
+Many1<P> many1(P parser) {
+    return Many1<P>{parser};
+}
+
+template <typename P>
+Named<P> named(P parser, string name) {
+    return Named<P>{parser, std::move(name)};
+}
+
+RuleRef ref(const Rule& rule) {
+    return RuleRef{&rule};
+}
+
+// Parses `source` with `parser` and builds the Result parser.h would.
+template <typename P>
+Result run(const P& parser, string_view source, Context& ctx) {
+    ctx.input = source;
+    ctx.results.clear();
+    ctx.failedAt = nullptr;
+
+    const char* end = nullptr;
+    parser(ctx, source.data(), [&](const char* position) { end = position; }, []() {});
+
+    if (end == nullptr) {
+        return Result::failure(ctx.error());
+    }
+    size_t length = end - source.data();
+    auto result = Result::success(source.substr(0, length), source.substr(length));
+    result.results = std::move(ctx.results);
+    return result;
+}
+
+template <typename P>
+Result run(const P& parser, string_view source) {
+    Context ctx;
+    return run(parser, source, ctx);
+}
+
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+// The grammar of grammar.h written for the continuation-passing engine.
+// cps::grammar::parse produces the same results as ::parse.
+
+#include "cps.h"
+
+namespace cps::grammar {
+
+auto whiteSpace = opt(many(oneOf(" \t\r\n")));
+auto digit  = range('0', '9');
+auto lower  = range('a', 'z');
+auto upper  = range('A', 'Z');
+auto letter = lower | upper;
+
+auto identifier = sequence(
+    letter,
+    many(letter | digit)
+);
+
+auto integer = many1(digit);
+
+auto structKeyword = literal("struct");
+auto constKeyword = literal("const");
+auto functionKeyword = literal("function");
+
+template <typename P>
+auto parseBlock(P parser) {
+    return sequence(
+        whiteSpace, character('{'),
+        parser,
+        whiteSpace, character('}')
+    );
+}
+
+template <typename P>
+auto parseBinary(P parser, string op1, string op2, string type) {
+    return named(
+        sequence(
+            named(parser, "left"),
+            many(
+                sequence(
+                    whiteSpace,
+                    named(choice(
+                        literal(op1),
+                        literal(op2)
+                    ), "operator"),
+                    whiteSpace,
+                    named(parser, "right")
+                )
+            )
+        ),
+        type
+    );
+}
+
+extern Rule blockParser;
+extern Rule expression;
+
+auto parenExp = sequence(
+    whiteSpace, character('('),
+    whiteSpace, ref(expression),
+    whiteSpace, character(')')
+);
+
+auto value = choice(
+    integer,
+    identifier
+);
+
+auto mulExp = parseBinary(value,  "*",  "/",  "MulExpression");
+auto addExp = parseBinary(mulExp, "+",  "-",  "AddExpression");
+auto eqExp  = parseBinary(addExp, "==", "!=", "EqualityExpression");
+
+Rule expression = eqExp;
+
+auto parseIf = named(
+    sequence(
+        whiteSpace, named(literal("if"), "type"),
+        whiteSpace, named(ref(expression), "condition"),
+        parseBlock(ref(blockParser))
+    ),
+    "if"
+);
+
+auto parseFor = named(
+    sequence(
+        whiteSpace, named(literal("for"), "type"),
+        whiteSpace, named(identifier, "variable"),
+        whiteSpace, literal("in"),
+        whiteSpace, named(value, "iterable"),
+        parseBlock(ref(blockParser))
+    ),
+    "for"
+);
+
+Rule blockParser = many(
+    choice(
+        parseIf,
+        parseFor
+    )
+);
+
+auto parseParameter = named(
+    sequence(
+        whiteSpace, named(identifier, "type"),
+        whiteSpace, named(identifier, "name")
+    ),
+    "parameter"
+);
+
+auto parseConst = named(
+    sequence(
+        whiteSpace, named(constKeyword, "type"),
+        whiteSpace, named(identifier, "name"),
+        whiteSpace, character('='),
+        whiteSpace, named(integer, "value")
+    ),
+    "const"
+);
+
+auto parseField = sequence(
+    whiteSpace, named(identifier, "name"),
+    whiteSpace, named(identifier, "field"),
+    whiteSpace, character(';')
+);
+
+// listOf(whiteSpace, parseParameter, ',') of parser.h.
+auto parameterList = sequence(
+    named(opt(sequence(whiteSpace, parseParameter)), "item"),
+    many(
+        sequence(
+            whiteSpace, character(','),
+            whiteSpace, parseParameter
+        )
+    )
+);
+
+auto parseFunction = named(
+    sequence(
+        whiteSpace, named(functionKeyword, "type"),
+        whiteSpace, named(identifier, "name"),
+        whiteSpace, character('('),
+        named(parameterList, "parameters"),
+        whiteSpace, character(')'),
+        parseBlock(
+            ref(blockParser)
+        )
+    ),
+    "function"
+);
+
+auto parseStruct = named(
+    sequence(
+        whiteSpace, named(structKeyword, "type"),
+        whiteSpace, named(identifier, "name"),
+        parseBlock(
+            many(
+                choice(
+                    parseField,
+                    parseFunction
+                )
+            )
+        )
+    ),
+    "struct"
+);
+
+auto declaration = choice(
+    parseStruct,
+    parseConst,
+    parseFunction
+);
+
+auto parse = named(
+    many(declaration),
+    "ast"
+);
+
+}
@@ -0,0 +1,301 @@
+#pragma once
+
+// Lossless concrete syntax tree with structural sharing.
+//
+// Green nodes are immutable and position-free: a kind, a width in bytes and
+// either token text or child nodes. They are hash-consed in a GreenInterner,
+// so identical subtrees - within a document, across reparses and across
+// edits - are one node in memory and compare equal by pointer.
+//
+// Red nodes are cheap cursors over a green tree that know their absolute
+// offset and parent, computed on demand while navigating.
+//
+// The tree is built by CstBuilder, a RuleObserver: every named rule that
+// matched becomes a node, and the bytes between nodes - whitespace and
+// punctuation the ResultMap drops - become tokens, so concatenating the
+// tokens of the root gives back the input exactly.
+
+#include "parser.h"
+
+#include <cctype>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+struct GreenNode {
+    uint32_t kind;
+    uint32_t width;
+    bool isToken;
+    string text;
+    vector<const GreenNode*> children;
+    size_t hash;
+};
+
+class GreenInterner {
+public:
+    uint32_t kind(const string& name) {
+        auto found = kindIds.find(name);
+        if (found != kindIds.end()) {
+            return found->second;
+        }
+        kindNames.push_back(name);
+        return kindIds[name] = uint32_t(kindNames.size() - 1);
+    }
+
+    const string& kindName(uint32_t kind) const { return kindNames[kind]; }
+
+    const GreenNode* token(uint32_t kind, string_view text) {
+        GreenNode node{kind, uint32_t(text.size()), true, string(text), {}, 0};
+        node.hash = hashOf(node);
+        return intern(std::move(node));
+    }
+
+    const GreenNode* node(uint32_t kind, vector<const GreenNode*> children) {
+        uint32_t width = 0;
+        for (auto child : children) {
+            width += child->width;
+        }
+        GreenNode node{kind, width, false, "", std::move(children), 0};
+        node.hash = hashOf(node);
+        return intern(std::move(node));
+    }
+
+    size_t size() const { return nodes.size(); }
+    size_t hits() const { return reused; }
+
+private:
+    static size_t hashOf(const GreenNode& node) {
+        size_t hash = std::hash<string>()(node.text) ^ (size_t(node.kind) * 0x9e3779b97f4a7c15ull);
+        for (auto child : node.children) {
+            hash = mixHash(hash, child->hash);
+        }
+        return hash;
+    }
+
+    struct Hash {
+        size_t operator()(const GreenNode* node) const { return node->hash; }
+    };
+
+    // Children are already interned, so comparing their pointers compares
+    // the whole subtree.
+    struct Equal {
+        bool operator()(const GreenNode* a, const GreenNode* b) const {
+            return a->kind == b->kind && a->width == b->width && a->isToken == b->isToken &&
+                   a->text == b->text && a->children == b->children;
+        }
+    };
+
+    const GreenNode* intern(GreenNode&& candidate) {
+        auto found = table.find(&candidate);
+        if (found != table.end()) {
+            reused++;
+            return *found;
+        }
+        nodes.push_back(std::move(candidate));
+        auto node = &nodes.back();
+        table.insert(node);
+        return node;
+    }
+
+    deque<GreenNode> nodes;
+    unordered_set<const GreenNode*, Hash, Equal> table;
+    vector<string> kindNames;
+    unordered_map<string, uint32_t> kindIds;
+    size_t reused = 0;
+};
+
+void appendText(const GreenNode* node, string& out) {
+    if (node->isToken) {
+        out += node->text;
+    }
+    for (auto child : node->children) {
+        appendText(child, out);
+    }
+}
+
+class RedNode {
+public:
+    RedNode(const GreenNode* green, size_t offset = 0, shared_ptr<const RedNode> parent = nullptr):
+        green(green), start(offset), up(std::move(parent)) {
+    }
+
+    const GreenNode* node() const { return green; }
+    uint32_t kind() const { return green->kind; }
+    size_t offset() const { return start; }
+    size_t end() const { return start + green->width; }
+    const shared_ptr<const RedNode>& parent() const { return up; }
+
+    string text() const {
+        string out;
+        appendText(green, out);
+        return out;
+    }
+
+    vector<RedNode> children() const {
+        vector<RedNode> result;
+        auto self = make_shared<const RedNode>(*this);
+        auto offset = start;
+        for (auto child : green->children) {
+            result.emplace_back(child, offset, self);
+            offset += child->width;
+        }
+        return result;
+    }
+
+    // The deepest token covering `position`, found by descending through
+    // child widths rather than visiting every node.
+    RedNode tokenAt(size_t position) const {
+        auto current = *this;
+        while (!current.green->isToken && !current.green->children.empty()) {
+            auto self = make_shared<const RedNode>(current);
+            auto offset = current.start;
+            auto next = current;
+            // Interned children repeat, so the last one is found by index.
+            auto& children = current.green->children;
+            for (size_t i = 0; i < children.size(); i++) {
+                if (position < offset + children[i]->width || i + 1 == children.size()) {
+                    next = RedNode(children[i], offset, self);
+                    break;
+                }
+                offset += children[i]->width;
+            }
+            current = next;
+        }
+        return current;
+    }
+
+private:
+    const GreenNode* green;
+    size_t start;
+    shared_ptr<const RedNode> up;
+};
+
+class CstBuilder : public RuleObserver {
+public:
+    CstBuilder(GreenInterner& interner, string_view input):
+        interner(interner),
+        input(input),
+        whitespaceKind(interner.kind("whitespace")),
+        wordKind(interner.kind("word")),
+        punctuationKind(interner.kind("punctuation")),
+        documentKind(interner.kind("document")) {
+        frames.push_back(Frame{0, {}});
+    }
+
+    void enter(const string&, string_view source) override {
+        frames.push_back(Frame{offset(source), {}});
+    }
+
+    void exit(const string& rule, const Result& result) override {
+        auto frame = std::move(frames.back());
+        frames.pop_back();
+
+        if (result.isFailure()) {
+            return;
+        }
+
+        auto end = frame.start + result.matched.size();
+        auto node = build(interner.kind(rule), frame, end);
+        frames.back().children.push_back(Span{frame.start, end, node});
+    }
+
+    // Nodes recorded by an attempt that was backtracked over are dropped
+    // by cutting the children back to their number when it began.
+    void beginAttempt() override {
+        attempts.push_back(frames.back().children.size());
+    }
+
+    void endAttempt(bool backtracked) override {
+        if (backtracked) {
+            frames.back().children.resize(attempts.back());
+        }
+        attempts.pop_back();
+    }
+
+    // The root of the tree, covering the whole input including anything the
+    // grammar left unparsed.
+    const GreenNode* finish() {
+        return build(documentKind, frames.front(), input.size());
+    }
+
+private:
+    struct Span {
+        size_t start;
+        size_t end;
+        const GreenNode* node;
+    };
+
+    struct Frame {
+        size_t start;
+        vector<Span> children;
+    };
+
+    size_t offset(string_view source) const {
+        return input.size() - source.size();
+    }
+
+    const GreenNode* build(uint32_t kind, Frame& frame, size_t end) {
+        vector<const GreenNode*> children;
+        auto position = frame.start;
+        for (auto& child : frame.children) {
+            addTokens(children, position, child.start);
+            children.push_back(child.node);
+            position = child.end;
+        }
+        addTokens(children, position, end);
+        return interner.node(kind, std::move(children));
+    }
+
+    // Splits the bytes no rule claimed into whitespace runs, word runs and
+    // single punctuation characters.
+    void addTokens(vector<const GreenNode*>& children, size_t start, size_t end) {
+        auto classOf = [](char ch) {
+            if (ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n') {
+                return 0;
+            }
+            if (isalnum((unsigned char)ch) || ch == '_') {
+                return 1;
+            }
+            return 2;
+        };
+
+        auto position = start;
+        while (position < end) {
+            auto kind = classOf(input[position]);
+            auto next = position + 1;
+            while (kind != 2 && next < end && classOf(input[next]) == kind) {
+                next++;
+            }
+            auto tokenKind = kind == 0 ? whitespaceKind : kind == 1 ? wordKind : punctuationKind;
+            children.push_back(interner.token(tokenKind, input.substr(position, next - position)));
+            position = next;
+        }
+    }
+
+    GreenInterner& interner;
+    string_view input;
+    uint32_t whitespaceKind;
+    uint32_t wordKind;
+    uint32_t punctuationKind;
+    uint32_t documentKind;
+    vector<Frame> frames;
+    // Number of children of the current frame when each open attempt began.
+    vector<size_t> attempts;
+};
+
+struct CstParse {
+    Result result;
+    const GreenNode* root;
+};
+
+CstParse parseCst(const Parser& parser, string_view input, GreenInterner& interner) {
+    CstBuilder builder(interner, input);
+
+    auto savedObserver = ruleObserver;
+    ruleObserver = &builder;
+    auto result = parser(input);
+    ruleObserver = savedObserver;
+
+    return CstParse{std::move(result), builder.finish()};
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// Hash-consed AST for repetitive input.
+//
+// Generated sources repeat the same struct bodies and if blocks thousands of
+// times, and a ResultMap stores every copy. An AstPool keeps one canonical
+// AstNode per distinct subtree instead: parse results are interned bottom-up,
+// hashing each node from its name, value and already canonical children, so
+// each duplicate costs one hash lookup and a shallow comparison against
+// canonical children. Two interned subtrees are equal exactly when their
+// pointers are.
+//
+// Interning needs the finished ResultMap, so it reduces the memory a parse
+// result keeps, not the peak memory of the parse itself.
+
+#include "parser.h"
+
+#include <deque>
+#include <unordered_map>
+
+struct AstNode {
+    string name;
+    bool isLeaf;
+    string value;
+    vector<const AstNode*> children;
+    size_t hash;
+};
+
+class AstPool {
+public:
+    const AstNode* intern(const ResultItem& item) {
+        interned++;
+
+        AstNode candidate{item.name, item.value.index() == 0, "", {}, 0};
+        auto hash = mixHash(hashBasis, std::hash<string>()(candidate.name));
+        if (candidate.isLeaf) {
+            candidate.value = std::get<0>(item.value);
+            hash = mixHash(hash, std::hash<string>()(candidate.value));
+        } else {
+            for (auto& child : std::get<1>(item.value)) {
+                candidate.children.push_back(intern(child));
+                hash = mixHash(hash, candidate.children.back()->hash);
+            }
+        }
+        candidate.hash = hash;
+
+        auto range = byHash.equal_range(candidate.hash);
+        for (auto found = range.first; found != range.second; found++) {
+            if (sameNode(*found->second, candidate)) {
+                return found->second;
+            }
+        }
+
+        nodes.push_back(std::move(candidate));
+        auto node = &nodes.back();
+        byHash.emplace(node->hash, node);
+        return node;
+    }
+
+    vector<const AstNode*> intern(const ResultMap& items) {
+        vector<const AstNode*> result;
+        for (auto& item : items) {
+            result.push_back(intern(item));
+        }
+        return result;
+    }
+
+    // Distinct nodes kept, against the number of nodes interned.
+    size_t size() const { return nodes.size(); }
+    size_t internedCount() const { return interned; }
+
+private:
+    // Children are canonical, so comparing their pointers is enough.
+    static bool sameNode(const AstNode& a, const AstNode& b) {
+        return a.isLeaf == b.isLeaf && a.name == b.name && a.value == b.value && a.children == b.children;
+    }
+
+    deque<AstNode> nodes;
+    unordered_multimap<size_t, const AstNode*> byHash;
+    size_t interned = 0;
+};
+
+// Rebuilds an ordinary ResultMap from interned nodes, for consumers that
+// need one.
+ResultMap expand(const vector<const AstNode*>& nodes) {
+    ResultMap result;
+    for (auto node : nodes) {
+        if (node->isLeaf) {
+            result.push_back(ResultItem::make(node->name, node->value));
+        } else {
+            result.push_back(ResultItem::make(node->name, expand(node->children)));
+        }
+    }
+    return result;
+}
+
+struct DedupParse {
+    ResultType status;
+    string_view matched;
+    string_view rest;
+    string error;
+    vector<const AstNode*> results;
+};
+
+// Parses `source` and keeps only the interned form of its tree; the
+// ResultMap is released before returning.
+DedupParse parseDeduplicated(const Parser& parser, string_view source, AstPool& pool) {
+    auto result = parser(source);
+    auto nodes = pool.intern(result.results);
+    return DedupParse{result.status, result.matched, result.rest, std::move(result.error), std::move(nodes)};
+}
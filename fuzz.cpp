@@ -0,0 +1,189 @@
+// Performance fuzzer for the grammar in grammar.h.
+//
+// Instead of looking for crashes it looks for inputs that make the combinators
+// do the most work per input byte, which is how exponential backtracking in
+// choice/many/refParser shows up. The slowest inputs found are written to a
+// regression corpus directory.
+//
+// Built with -DFUZZ_LIBFUZZER -fsanitize=fuzzer it only provides the libFuzzer
+// entry point. Otherwise it is a standalone mutation driver:
+//
+//     fuzz [corpus-dir] [iterations] [seed]
+
+#include "grammar.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace fs = std::filesystem;
+
+// Short inputs always have a high constant overhead, so the cost of anything
+// shorter than this is measured as if it had this length.
+const size_t minCostLength = 32;
+const size_t maxInputLength = 1024;
+
+double stepsPerByte(const string& input) {
+    combinatorSteps = 0;
+    parse(input);
+    return double(combinatorSteps) / double(max(input.size(), minCostLength));
+}
+
+string corpusFileName(const string& input) {
+    stringstream name;
+    name << "slow-" << hex << fnv1a(input) << ".in";
+    return name.str();
+}
+
+void saveToCorpus(const fs::path& dir, const string& input) {
+    fs::create_directories(dir);
+    ofstream file(dir / corpusFileName(input), ios::binary);
+    file << input;
+}
+
+#ifdef FUZZ_LIBFUZZER
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    static double slowest = 0;
+
+    if (size > maxInputLength) {
+        return 0;
+    }
+
+    string input(reinterpret_cast<const char*>(data), size);
+    auto cost = stepsPerByte(input);
+
+    if (cost > slowest) {
+        slowest = cost;
+        auto dir = getenv("FUZZ_CORPUS");
+        saveToCorpus(dir ? dir : "fuzz-corpus", input);
+    }
+    return 0;
+}
+
+#else
+
+struct Candidate {
+    string input;
+    double cost;
+};
+
+const vector<string> dictionary = {
+    "struct", "const", "function", "if", "for", "in",
+    "{", "}", "(", ")", ";", ",", "=", "==", "!=", "+", "-", "*", "/",
+    " ", "\n", "\t", "x", "Point", "100", "a * b", "int a", "if a {}"
+};
+
+const vector<string> seeds = {
+    "const x = 100",
+    "struct Point { int x; int y; }",
+    "struct Line { Point a; function toString() { } }",
+    "function main (int a, int b) { if a * b + 5 == 1000 { } }",
+    "function f () { for i in xs { if a { } } }",
+};
+
+string mutate(string input, mt19937& rng, const vector<Candidate>& population) {
+    auto pick = [&rng](size_t n) { return n == 0 ? 0 : size_t(rng() % n); };
+    auto rounds = 1 + pick(4);
+
+    for (size_t round = 0; round < rounds; round++) {
+        auto pos = pick(input.size() + 1);
+
+        switch (pick(6)) {
+        case 0:
+            input.insert(pos, dictionary[pick(dictionary.size())]);
+            break;
+        case 1:
+            if (!input.empty()) {
+                input.erase(pick(input.size()), 1 + pick(8));
+            }
+            break;
+        case 2:
+            if (!input.empty()) {
+                input[pick(input.size())] = char(rng());
+            }
+            break;
+        case 3: {
+            // Duplicating a slice is what builds deep nesting and long lists.
+            auto start = pick(input.size());
+            auto slice = input.substr(start, 1 + pick(64));
+            input.insert(pos, slice);
+            break;
+        }
+        case 4: {
+            auto& other = population[pick(population.size())].input;
+            auto start = pick(other.size());
+            input.insert(pos, other.substr(start, 1 + pick(64)));
+            break;
+        }
+        default:
+            input.insert(pos, string(1, "{}()"[pick(4)]));
+            break;
+        }
+    }
+
+    if (input.size() > maxInputLength) {
+        input.resize(maxInputLength);
+    }
+    return input;
+}
+
+vector<Candidate> loadCorpus(const fs::path& dir) {
+    vector<Candidate> result;
+    for (auto& seed : seeds) {
+        result.push_back(Candidate{seed, stepsPerByte(seed)});
+    }
+    if (fs::is_directory(dir)) {
+        for (auto& entry : fs::directory_iterator(dir)) {
+            ifstream file(entry.path(), ios::binary);
+            stringstream content;
+            content << file.rdbuf();
+            auto input = content.str();
+            result.push_back(Candidate{input, stepsPerByte(input)});
+        }
+    }
+    return result;
+}
+
+int main(int argc, char** argv) {
+    fs::path corpus = argc > 1 ? argv[1] : "fuzz-corpus";
+    size_t iterations = argc > 2 ? stoul(argv[2]) : 5000;
+    unsigned seed = argc > 3 ? stoul(argv[3]) : 1;
+
+    const size_t populationSize = 32;
+    const size_t keep = 8;
+
+    mt19937 rng(seed);
+    auto population = loadCorpus(corpus);
+
+    auto bySlowest = [](const Candidate& a, const Candidate& b) { return a.cost > b.cost; };
+    sort(population.begin(), population.end(), bySlowest);
+
+    for (size_t i = 0; i < iterations; i++) {
+        auto& parent = population[rng() % population.size()];
+        auto input = mutate(parent.input, rng, population);
+        auto cost = stepsPerByte(input);
+
+        if (population.size() < populationSize || cost > population.back().cost) {
+            population.push_back(Candidate{input, cost});
+            sort(population.begin(), population.end(), bySlowest);
+            if (population.size() > populationSize) {
+                population.resize(populationSize);
+            }
+        }
+
+        if ((i + 1) % 1000 == 0) {
+            cout << "iteration " << (i + 1) << ": slowest " << population.front().cost << " steps/byte\n";
+        }
+    }
+
+    for (size_t i = 0; i < min(keep, population.size()); i++) {
+        saveToCorpus(corpus, population[i].input);
+        cout << population[i].cost << " steps/byte, " << population[i].input.size() << " bytes -> "
+             << (corpus / corpusFileName(population[i].input)).string() << "\n";
+    }
+}
+
+#endif
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "grammar_handle.h"
+#include "predictive.h"
+
+// Character-class programs of the regular rules, for the JIT and for batch
+// validation.
+ScanProgram whiteSpaceProgram = {
+    {charClass(" \t\r\n"), false, true}
+};
+ScanProgram identifierProgram = {
+    {charRange('a', 'z') | charRange('A', 'Z'), true, false},
+    {charRange('a', 'z') | charRange('A', 'Z') | charRange('0', '9'), false, true}
+};
+ScanProgram integerProgram = {
+    {charRange('0', '9'), true, true}
+};
+
+auto whiteSpace = compiledRule("whiteSpace", whiteSpaceProgram, opt(many(anyOf(" \t\r\n"))));
+
+auto digit  = anyOf('0', '9');
+auto lower  = anyOf('a', 'z');
+auto upper  = anyOf('A', 'Z');
+auto letter = choice({lower, upper});
+
+auto identifier = compiledRule("identifier", identifierProgram, sequence({
+    letter,
+    many(choice({letter, digit}))
+}));
+
+auto integer = compiledRule("integer", integerProgram, many1(digit));
+
+auto structKeyword = compiledRule("struct", keywordProgram("struct"), parseString("struct"));
+auto constKeyword = compiledRule("const", keywordProgram("const"), parseString("const"));
+auto functionKeyword = compiledRule("function", keywordProgram("function"), parseString("function"));
+
+
+Parser parseBlock (Parser parser) {
+    return sequence({
+        whiteSpace, parseChar('{'),
+        parser,
+        whiteSpace, parseChar('}')
+    });
+}
+
+Parser parseBinary(Parser parser, string op1, string op2, string type) {
+    return  mapTo(
+        sequence({
+            mapTo(parser, "left"),
+            many(
+                sequence({
+                    whiteSpace,
+                    mapTo(predictive(type + " operator", {
+                        parseString(op1),
+                        parseString(op2)
+                    }), "operator"),
+                    whiteSpace,
+                    mapTo(parser, "right")
+                })
+            )
+        }),
+        type
+    );
+}
+
+// Builds the grammar as a self-contained Grammar whose rules refer to each
+// other through Grammar::ref(), so independent versions can be built and
+// replaced while others are in use. `equal` and `notEqual` are the
+// operators of equality expressions, for building dialects. The global
+// rules below are those of one default version.
+unique_ptr<Grammar> makeGrammar(string equal = "==", string notEqual = "!=") {
+    auto grammar = make_unique<Grammar>();
+    auto& g = *grammar;
+
+    g.rules["parenExp"] = sequence({
+        whiteSpace, parseChar('('),
+        whiteSpace, g.ref("expression"),
+        whiteSpace, parseChar(')')
+    });
+
+    auto value = predictive("value", {
+        integer,
+        identifier
+    });
+
+    auto mulExp = parseBinary(value,  "*",  "/",  "MulExpression");
+    auto addExp = parseBinary(mulExp, "+",  "-",  "AddExpression");
+    auto eqExp  = parseBinary(addExp, equal, notEqual, "EqualityExpression");
+
+    g.rules["expression"] = eqExp;
+
+    auto parseIf = mapTo(
+        sequence({
+            whiteSpace, mapTo(parseString("if"), "type"),
+            whiteSpace, mapTo(eqExp, "condition"),
+            parseBlock(g.ref("block"))
+        }),
+        "if"
+    );
+
+    auto parseFor = mapTo(
+        sequence({
+            whiteSpace, mapTo(parseString("for"), "type"),
+            whiteSpace, mapTo(identifier, "variable"),
+            whiteSpace, parseString("in"),
+            whiteSpace, mapTo(value, "iterable"),
+            parseBlock(g.ref("block"))
+        }),
+        "for"
+    );
+
+    g.rules["block"] = many(
+        predictive("statement", {
+            parseIf,
+            parseFor,
+        })
+    );
+
+    auto parseParameter = mapTo(
+        sequence({
+            whiteSpace, mapTo(identifier, "type"),
+            whiteSpace, mapTo(identifier, "name"),
+        }),
+        "parameter"
+    );
+
+    auto parseConst = mapTo(
+        sequence({
+            whiteSpace, mapTo(constKeyword, "type"),
+            whiteSpace, mapTo(identifier, "name"),
+            whiteSpace, parseChar('='),
+            whiteSpace, mapTo(integer, "value")
+        }),
+        "const"
+    );
+
+    auto parseField = sequence({
+        whiteSpace, mapTo(identifier, "name"),
+        whiteSpace, mapTo(identifier, "field"),
+        whiteSpace, parseChar(';')
+    });
+
+    auto parseFunction = mapTo(
+        sequence({
+            whiteSpace, mapTo(functionKeyword, "type"),
+            whiteSpace, mapTo(identifier, "name"),
+            whiteSpace, parseChar('('),
+            mapTo(listOf(whiteSpace, parseParameter, ','), "parameters"),
+            whiteSpace, parseChar(')'),
+            parseBlock(
+                g.ref("block")
+            )
+        }),
+        "function"
+    );
+
+    auto parseStruct = mapTo(
+        sequence({
+            whiteSpace, mapTo(structKeyword, "type"),
+            whiteSpace, mapTo(identifier, "name"),
+            parseBlock(
+                many(
+                    predictive("member", {
+                        parseField,
+                        parseFunction
+                    })
+                )
+            )
+        }),
+        "struct"
+    );
+
+    auto declaration = predictive("declaration", {
+        parseStruct,
+        parseConst,
+        parseFunction
+    });
+    g.rules["declaration"] = declaration;
+
+    g.start = mapTo(
+        many(declaration),
+        "ast"
+    );
+    return grammar;
+}
+
+auto defaultGrammar = makeGrammar();
+
+Parser& expression = defaultGrammar->rules["expression"];
+Parser& blockParser = defaultGrammar->rules["block"];
+Parser& declaration = defaultGrammar->rules["declaration"];
+Parser& parse = defaultGrammar->start;
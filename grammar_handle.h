@@ -0,0 +1,210 @@
+#pragma once
+
+// Replaceable grammars for programs that parse on many threads.
+//
+// The global rules of grammar.h belong to one Grammar built at startup, so
+// assigning to one while another thread parses with it is a data race.
+// makeGrammar() builds independent versions instead, and a GrammarHandle
+// owns them as immutable Grammar versions.
+// publish() installs a new version with one atomic exchange; every parse
+// pins the version that was current when it started and finishes on it.
+//
+// Replaced versions are freed by epoch-based reclamation. A parse announces
+// the global epoch it started in, in a slot owned by its thread, and clears
+// it when done. Publishing advances the epoch, so a version replaced in
+// epoch e can only be in use by parses that announced an epoch <= e, and it
+// is deleted once no slot holds one. Parsing takes no lock: pinning is one
+// load and one store to the thread's own slot. Writers serialise on a mutex.
+
+#include "parser.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// One version of a grammar. Rules refer to each other through ref(), which
+// stays valid for as long as the grammar does, so a rule can be used before
+// it is defined and a Grammar is self-contained.
+struct Grammar {
+    map<string, Parser> rules;
+    Parser start;
+    // Set by GrammarHandle::publish().
+    uint64_t version = 0;
+
+    Parser ref(const string& name) {
+        return refParser(rules[name]);
+    }
+};
+
+// Epochs of the threads that are reading shared grammars.
+class EpochDomain {
+public:
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    // Marks the calling thread as reading from now on. Pins nest.
+    void enter() {
+        auto slot = threadSlot();
+        if (slot->depth++ == 0) {
+            slot->epoch.store(epoch.load());
+        }
+    }
+
+    void exit() {
+        auto slot = threadSlot();
+        if (--slot->depth == 0) {
+            slot->epoch.store(0, memory_order_release);
+        }
+    }
+
+    // Starts a new epoch and returns the one that ended.
+    uint64_t advance() {
+        return epoch.fetch_add(1);
+    }
+
+    // Whether no thread is still reading since `ended` or earlier.
+    bool quiescent(uint64_t ended) const {
+        for (auto slot = slots.load(memory_order_acquire); slot != nullptr; slot = slot->next) {
+            auto pinned = slot->epoch.load();
+            if (pinned != 0 && pinned <= ended) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    // Slots are padded to a cache line each so readers do not share one.
+    // They are reused when their thread exits and never freed.
+    struct alignas(64) Slot {
+        atomic<uint64_t> epoch{0};
+        atomic<bool> used{true};
+        Slot* next = nullptr;
+        // Pins held by the owning thread.
+        size_t depth = 0;
+    };
+
+    struct SlotOwner {
+        Slot* slot;
+
+        explicit SlotOwner(EpochDomain& domain): slot(domain.acquire()) {}
+        ~SlotOwner() {
+            slot->epoch.store(0);
+            slot->used.store(false, memory_order_release);
+        }
+    };
+
+    atomic<uint64_t> epoch{1};
+    atomic<Slot*> slots{nullptr};
+
+    Slot* acquire() {
+        for (auto slot = slots.load(memory_order_acquire); slot != nullptr; slot = slot->next) {
+            auto used = false;
+            if (!slot->used.load() && slot->used.compare_exchange_strong(used, true)) {
+                return slot;
+            }
+        }
+        auto slot = new Slot();
+        slot->next = slots.load();
+        while (!slots.compare_exchange_weak(slot->next, slot)) {
+        }
+        return slot;
+    }
+
+    Slot* threadSlot() {
+        thread_local SlotOwner owner(*this);
+        return owner.slot;
+    }
+};
+
+class GrammarHandle {
+public:
+    explicit GrammarHandle(unique_ptr<Grammar> grammar) {
+        publish(std::move(grammar));
+    }
+
+    GrammarHandle(const GrammarHandle&) = delete;
+    GrammarHandle& operator=(const GrammarHandle&) = delete;
+
+    // No parse may still be running on the handle.
+    ~GrammarHandle() {
+        delete current.load();
+        for (auto& entry : retired) {
+            delete entry.second;
+        }
+    }
+
+    // Calls `body` with the current grammar, which stays alive until it
+    // returns even if another version is published meanwhile.
+    template <typename Body>
+    auto read(Body body) const {
+        struct Pin {
+            Pin() { EpochDomain::instance().enter(); }
+            ~Pin() { EpochDomain::instance().exit(); }
+        } pin;
+        return body(static_cast<const Grammar&>(*current.load()));
+    }
+
+    Result parse(string_view source) const {
+        return read([source](const Grammar& grammar) {
+            return grammar.start(source);
+        });
+    }
+
+    // A parser that runs the start rule of the current grammar, for use
+    // inside other grammars in place of refParser().
+    Parser parser() const {
+        return [this](string_view source) -> Result {
+            combinatorSteps++;
+            return parse(source);
+        };
+    }
+
+    // Makes `grammar` the one new parses use and returns its version.
+    // Parses already running keep the previous one.
+    uint64_t publish(unique_ptr<Grammar> grammar) {
+        lock_guard<mutex> lock(writer);
+        auto version = grammar->version = ++versions;
+        auto previous = current.exchange(grammar.release());
+        if (previous != nullptr) {
+            retired.push_back({EpochDomain::instance().advance(), previous});
+        }
+        reclaimRetired();
+        return version;
+    }
+
+    // Deletes replaced grammars no parse can still be using and returns how
+    // many remain.
+    size_t reclaim() {
+        lock_guard<mutex> lock(writer);
+        return reclaimRetired();
+    }
+
+    uint64_t version() const {
+        return read([](const Grammar& grammar) { return grammar.version; });
+    }
+
+private:
+    atomic<Grammar*> current{nullptr};
+    mutex writer;
+    uint64_t versions = 0;
+    // Replaced grammars with the epoch they were replaced in, oldest first.
+    vector<pair<uint64_t, Grammar*>> retired;
+
+    size_t reclaimRetired() {
+        auto& domain = EpochDomain::instance();
+        size_t kept = 0;
+        for (auto& entry : retired) {
+            if (domain.quiescent(entry.first)) {
+                delete entry.second;
+            } else {
+                retired[kept++] = entry;
+            }
+        }
+        retired.resize(kept);
+        return kept;
+    }
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+// Gzip-compressed input for InputWindow, decompressed by the system zlib as
+// the parser asks for more. Concatenated gzip members are read as one
+// stream, and files that are not compressed are passed through unchanged.
+//
+// Link with -lz.
+
+#include "input_window.h"
+
+#include <memory>
+
+#include <zlib.h>
+
+class GzipSource {
+public:
+    explicit GzipSource(const string& path): file(gzopen(path.c_str(), "rb"), gzclose) {
+        if (file) {
+            gzbuffer(file.get(), 128 * 1024);
+        }
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    size_t operator()(char* buffer, size_t size, string& error) {
+        if (!file) {
+            error = "cannot open file";
+            return 0;
+        }
+        auto count = gzread(file.get(), buffer, unsigned(size));
+        if (count < 0) {
+            int code;
+            error = gzerror(file.get(), &code);
+            return 0;
+        }
+        return size_t(count);
+    }
+
+private:
+    shared_ptr<gzFile_s> file;
+};
+
+// Parses the declarations of the gzip file at `path` in one pass.
+StreamSummary parseGzipDeclarations(const string& path, const std::function<void(Result&&)>& onDeclaration,
+                                    size_t chunkSize = 64 * 1024) {
+    GzipSource source(path);
+    if (!source.isOpen()) {
+        StreamSummary summary;
+        summary.error = "cannot open " + path;
+        return summary;
+    }
+    InputWindow window(source, chunkSize);
+    return parseDeclarations(window, onDeclaration);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+// Latency histogram in the style of HdrHistogram: values are bucketed by
+// power of two, and every power of two is split into a fixed number of
+// linear sub-buckets, so any recorded value is reported within about 1.5%
+// of its true value while the whole range of uint64_t fits in a few
+// thousand counters. Recording is a couple of shifts and an increment, so
+// each thread keeps its own histogram and they are merged afterwards. The
+// counters are held inline rather than in a heap buffer, so a histogram
+// aligned to a cache line shares no line with another thread's.
+
+#include <array>
+#include <cstdint>
+
+class Histogram {
+public:
+    // Values below 128 are exact; above that each power of two gets 64
+    // sub-buckets, a relative error of at most 1/64.
+    static const int subBucketBits = 7;
+    static const uint64_t subBuckets = uint64_t(1) << subBucketBits;
+
+    void record(uint64_t value) {
+        counts[index(value)]++;
+        total++;
+        if (value > maximum) {
+            maximum = value;
+        }
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < counts.size(); i++) {
+            counts[i] += other.counts[i];
+        }
+        total += other.total;
+        if (other.maximum > maximum) {
+            maximum = other.maximum;
+        }
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t max() const { return maximum; }
+
+    // Smallest recorded value such that `percentile` percent of all values
+    // are at or below it, reported as the top of its bucket.
+    uint64_t percentile(double percentile) const {
+        if (total == 0) {
+            return 0;
+        }
+
+        auto wanted = uint64_t(percentile / 100.0 * double(total) + 0.5);
+        if (wanted == 0) {
+            wanted = 1;
+        }
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= wanted) {
+                auto top = highestEquivalent(i);
+                return top < maximum ? top : maximum;
+            }
+        }
+        return maximum;
+    }
+
+private:
+    // Values below subBuckets get exact buckets. Above that, the bucket is
+    // the position of the highest set bit, and the sub-bucket the next
+    // subBucketBits bits below it.
+    static size_t index(uint64_t value) {
+        if (value < subBuckets) {
+            return size_t(value);
+        }
+        int magnitude = 63 - __builtin_clzll(value) - subBucketBits + 1;
+        auto subBucket = (value >> magnitude) - subBuckets / 2;
+        return size_t((magnitude + 1) * (subBuckets / 2) + subBucket);
+    }
+
+    static uint64_t highestEquivalent(size_t index) {
+        if (index < subBuckets) {
+            return index;
+        }
+        auto magnitude = index / (subBuckets / 2) - 1;
+        auto subBucket = index % (subBuckets / 2) + subBuckets / 2;
+        return ((subBucket + 1) << magnitude) - 1;
+    }
+
+    std::array<uint64_t, (64 - subBucketBits + 1) * subBuckets> counts {};
+    uint64_t total = 0;
+    uint64_t maximum = 0;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+// Parsing of inputs that arrive in chunks.
+//
+// InputWindow keeps the unparsed tail of a stream in one buffer and pulls
+// more from a ChunkSource when asked. parseDeclarations() runs `declaration`
+// on the window over and over, hands every declaration to a callback and
+// drops its text from the window, so memory stays bounded by the largest
+// declaration rather than the whole input.
+//
+// A declaration is only final when parsing it never looked past the end of
+// the window (see sawEndOfInput); otherwise the window is refilled and the
+// declaration parsed again. Results are the ones `parse` would put under
+// "ast", one declaration at a time.
+
+#include "grammar.h"
+
+// Reads up to `size` bytes into `buffer` and returns how many were read;
+// 0 means the stream has ended. Errors are reported through `error`.
+using ChunkSource = std::function<size_t(char* buffer, size_t size, string& error)>;
+
+class InputWindow {
+public:
+    explicit InputWindow(ChunkSource source, size_t chunkSize = 64 * 1024):
+        source(std::move(source)),
+        chunkSize(chunkSize) {
+    }
+
+    string_view view() const { return string_view(buffer).substr(start); }
+    bool atEnd() const { return ended; }
+    // Bytes dropped from the front of the window so far.
+    uint64_t offset() const { return dropped; }
+    const string& error() const { return readError; }
+
+    // Appends the next chunk; false once the stream has ended or failed.
+    bool fill() {
+        if (ended) {
+            return false;
+        }
+
+        // Move the unparsed tail to the front once it is less than half of
+        // the buffer, so the buffer never holds much already-parsed text.
+        if (start > 0 && start >= buffer.size() - start) {
+            buffer.erase(0, start);
+            start = 0;
+        }
+
+        auto size = buffer.size();
+        buffer.resize(size + chunkSize);
+        auto count = source(&buffer[size], chunkSize, readError);
+        buffer.resize(size + count);
+        if (count == 0) {
+            ended = true;
+        }
+        return count > 0;
+    }
+
+    void consume(size_t count) {
+        start += count;
+        dropped += count;
+    }
+
+    size_t capacity() const { return buffer.capacity(); }
+
+private:
+    ChunkSource source;
+    size_t chunkSize;
+    string buffer;
+    size_t start = 0;
+    uint64_t dropped = 0;
+    bool ended = false;
+    string readError;
+};
+
+struct StreamSummary {
+    bool parsed = false;
+    string error;
+    // Declarations parsed and bytes of input they covered.
+    size_t declarations = 0;
+    uint64_t bytes = 0;
+    // Largest the window grew to.
+    size_t peakWindow = 0;
+};
+
+// Parses declarations from `window` until the stream ends, calling
+// `onDeclaration` with each result. The result's matched and rest views
+// point into the window and are only valid during the call. A declaration
+// that does not fit in `maxWindow` bytes is an error.
+StreamSummary parseDeclarations(InputWindow& window, const std::function<void(Result&&)>& onDeclaration,
+                                size_t maxWindow = 64 * 1024 * 1024) {
+    StreamSummary summary;
+
+    while (true) {
+        auto input = window.view();
+        summary.peakWindow = max(summary.peakWindow, window.capacity());
+
+        auto savedEnd = sawEndOfInput;
+        sawEndOfInput = false;
+        auto result = declaration(input);
+        auto final = !sawEndOfInput || window.atEnd();
+        sawEndOfInput = savedEnd;
+
+        if (!final) {
+            if (input.size() >= maxWindow) {
+                summary.error = "declaration at offset " + to_string(window.offset()) + " exceeds the window";
+                return summary;
+            }
+            window.fill();
+            continue;
+        }
+
+        if (result.isFailure() || result.matched.empty()) {
+            auto rest = input;
+            rest.remove_prefix(min(rest.find_first_not_of(" \t\r\n"), rest.size()));
+            summary.bytes = window.offset() + input.size();
+            if (!window.error().empty()) {
+                summary.error = window.error();
+            } else if (!rest.empty()) {
+                summary.error = "unexpected input at offset " + to_string(window.offset() + (input.size() - rest.size()));
+            } else {
+                summary.parsed = true;
+            }
+            return summary;
+        }
+
+        auto length = result.matched.size();
+        summary.declarations++;
+        onDeclaration(std::move(result));
+        window.consume(length);
+    }
+}
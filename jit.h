@@ -0,0 +1,288 @@
+#pragma once
+
+// JIT compilation of regular grammar rules to x86-64.
+//
+// Rules such as whiteSpace, identifier, integer and the keywords are plain
+// runs of character classes, yet interpreting them costs a chain of
+// std::function calls and a failure Result per character tried. A
+// ScanProgram describes such a rule as a sequence of steps - "one character
+// from this class", "any number of characters from this class" - and
+// RuleJit turns it into a native function
+//
+//     int64_t scan(const char* position, const char* end)
+//
+// that returns the number of bytes matched, or -1 - n when the byte at
+// offset n does not fit (n may be the end). Each step tests a byte
+// with one `bt` against a 256-bit class table. The emitter is hand-written
+// and has no dependencies. Code lives in pages that are written and then
+// made executable, never both, and every function is listed in
+// /tmp/perf-<pid>.map so `perf` attributes samples to rule names.
+//
+// The JIT is off unless the environment variable PARSER_JIT is set, and on
+// anything other than x86-64 Linux compiledRule() always returns the
+// interpreted parser. Compiled rules produce the same matches as the
+// interpreted ones, but fail with one "Expected <rule>" error instead of
+// the last character comparison.
+
+#include "parser.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define PARSER_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using CharClass = array<uint64_t, 4>;
+
+CharClass charClass(string_view chars) {
+    CharClass result{};
+    for (unsigned char ch : chars) {
+        result[ch / 64] |= uint64_t(1) << (ch % 64);
+    }
+    return result;
+}
+
+CharClass charRange(char start, char end) {
+    CharClass result{};
+    for (int ch = (unsigned char)start; ch <= (unsigned char)end; ch++) {
+        result[ch / 64] |= uint64_t(1) << (ch % 64);
+    }
+    return result;
+}
+
+CharClass operator|(CharClass a, const CharClass& b) {
+    for (size_t i = 0; i < a.size(); i++) {
+        a[i] |= b[i];
+    }
+    return a;
+}
+
+struct ScanStep {
+    CharClass chars;
+    // At least one character of the class must match.
+    bool required;
+    // Keep matching characters of the class for as long as possible.
+    bool repeat;
+};
+
+using ScanProgram = vector<ScanStep>;
+
+// The program matching exactly `keyword`.
+ScanProgram keywordProgram(string_view keyword) {
+    ScanProgram program;
+    for (auto ch : keyword) {
+        program.push_back(ScanStep{charClass(string_view(&ch, 1)), true, false});
+    }
+    return program;
+}
+
+using ScanFunction = int64_t (*)(const char*, const char*);
+
+class RuleJit {
+public:
+    static bool supported() {
+#ifdef PARSER_JIT_SUPPORTED
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static bool enabledByEnvironment() {
+        auto value = getenv("PARSER_JIT");
+        return value != nullptr && string(value) != "0";
+    }
+
+    // The process-wide JIT, created on first use so grammar globals can
+    // compile through it during static initialisation.
+    static RuleJit& instance() {
+        static RuleJit jit;
+        return jit;
+    }
+
+    RuleJit(const RuleJit&) = delete;
+    RuleJit& operator=(const RuleJit&) = delete;
+
+    ~RuleJit() {
+#ifdef PARSER_JIT_SUPPORTED
+        for (auto& page : pages) {
+            munmap(page.first, page.second);
+        }
+#endif
+    }
+
+    // Native code for `program`, or nullptr when the JIT is unsupported or
+    // the code could not be mapped.
+    ScanFunction compile(const string& name, const ScanProgram& program) {
+#ifdef PARSER_JIT_SUPPORTED
+        auto code = emit(program);
+
+        auto pageSize = size_t(sysconf(_SC_PAGESIZE));
+        auto size = (code.size() + pageSize - 1) / pageSize * pageSize;
+        auto memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+        memcpy(memory, code.data(), code.size());
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(memory, size);
+            return nullptr;
+        }
+        pages.push_back({memory, size});
+
+        ofstream perfMap("/tmp/perf-" + to_string(getpid()) + ".map", ios::app);
+        perfMap << hex << reinterpret_cast<uintptr_t>(memory) << " " << code.size() << " jit:" << name << "\n";
+
+        return reinterpret_cast<ScanFunction>(memory);
+#else
+        (void)name;
+        (void)program;
+        return nullptr;
+#endif
+    }
+
+private:
+    RuleJit() {}
+
+#ifdef PARSER_JIT_SUPPORTED
+    struct Emitter {
+        vector<uint8_t> code;
+        vector<size_t> failJumps;
+
+        void bytes(initializer_list<uint8_t> values) {
+            code.insert(code.end(), values);
+        }
+
+        void imm32(int32_t value) {
+            for (int i = 0; i < 4; i++) {
+                code.push_back(uint8_t(value >> (8 * i)));
+            }
+        }
+
+        void imm64(uint64_t value) {
+            for (int i = 0; i < 8; i++) {
+                code.push_back(uint8_t(value >> (8 * i)));
+            }
+        }
+
+        // jae rel32 to a label that is patched later; returns the position
+        // of the displacement.
+        size_t jaeForward() {
+            bytes({0x0F, 0x83});
+            imm32(0);
+            return code.size() - 4;
+        }
+
+        void patch(size_t displacement, size_t target) {
+            auto relative = int32_t(int64_t(target) - int64_t(displacement + 4));
+            memcpy(&code[displacement], &relative, 4);
+        }
+
+        // Branches to `miss` (via jae) unless the byte at rdi is in the
+        // class table at rdx: cmp rdi, rsi; jae miss; movzx ecx, [rdi];
+        // bt [rdx], ecx; jnc miss.
+        void testByte(vector<size_t>& miss) {
+            bytes({0x48, 0x39, 0xF7});
+            miss.push_back(jaeForward());
+            bytes({0x0F, 0xB6, 0x0F});
+            bytes({0x0F, 0xA3, 0x0A});
+            miss.push_back(jaeForward());
+        }
+    };
+
+    vector<uint8_t> emit(const ScanProgram& program) {
+        Emitter e;
+
+        // mov r8, rdi - remember the start.
+        e.bytes({0x49, 0x89, 0xF8});
+
+        for (auto& step : program) {
+            tables.push_back(step.chars);
+
+            // movabs rdx, &table
+            e.bytes({0x48, 0xBA});
+            e.imm64(reinterpret_cast<uint64_t>(tables.back().data()));
+
+            if (step.required) {
+                e.testByte(e.failJumps);
+                // inc rdi
+                e.bytes({0x48, 0xFF, 0xC7});
+            }
+
+            if (step.repeat) {
+                auto loop = e.code.size();
+                vector<size_t> done;
+                e.testByte(done);
+                e.bytes({0x48, 0xFF, 0xC7});
+                // jmp loop
+                e.bytes({0xE9});
+                e.imm32(int32_t(int64_t(loop) - int64_t(e.code.size() + 4)));
+                for (auto jump : done) {
+                    e.patch(jump, e.code.size());
+                }
+            }
+        }
+
+        // mov rax, rdi; sub rax, r8; ret
+        e.bytes({0x48, 0x89, 0xF8, 0x4C, 0x29, 0xC0, 0xC3});
+
+        // fail: mov rax, r8; sub rax, rdi; dec rax; ret
+        for (auto jump : e.failJumps) {
+            e.patch(jump, e.code.size());
+        }
+        e.bytes({0x4C, 0x89, 0xC0, 0x48, 0x29, 0xF8, 0x48, 0xFF, 0xC8, 0xC3});
+
+        return e.code;
+    }
+
+    // Class tables are referenced by address from generated code, so they
+    // live in a deque that never moves its elements.
+    deque<CharClass> tables;
+    vector<pair<void*, size_t>> pages;
+#endif
+};
+
+// A rule running compiled code. It keeps its program so that analyses can
+// still see what it matches.
+struct CompiledRuleParser {
+    ScanFunction scan;
+    string error;
+    ScanProgram program;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        auto length = scan(source.data(), source.data() + source.size());
+        if (length < 0) {
+            if (size_t(-1 - length) == source.size()) {
+                sawEndOfInput = true;
+            }
+            return Result::failure(error);
+        }
+        if (size_t(length) == source.size()) {
+            sawEndOfInput = true;
+        }
+        return Result::success(source.substr(0, length), source.substr(length));
+    }
+};
+
+// `fallback` compiled to native code when the JIT is enabled and supported,
+// otherwise `fallback` itself.
+Parser compiledRule(const string& name, const ScanProgram& program, Parser fallback) {
+    if (!RuleJit::supported() || !RuleJit::enabledByEnvironment()) {
+        return fallback;
+    }
+
+    auto scan = RuleJit::instance().compile(name, program);
+    if (scan == nullptr) {
+        return fallback;
+    }
+
+    return CompiledRuleParser{scan, "Expected " + name, program};
+}
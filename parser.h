@@ -0,0 +1,519 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <iostream>
+#include <functional>
+#include <vector>
+#include <map>
+#include <variant>
+
+using namespace std;
+
+// Whether results built on the current thread get subtree hashes. Hashing
+// costs a string hash per leaf and a pass over every node's children, so it
+// is off unless a consumer such as ast_diff.h needs it.
+inline thread_local bool subtreeHashes = false;
+
+// Subtree hashes are FNV-1a taken over whole words: start from hashBasis
+// and mix in the hash of the name, then of the leaf value or of each child.
+const size_t hashBasis = 14695981039346656037ull;
+
+size_t mixHash(size_t hash, size_t value) {
+    return (hash ^ value) * 1099511628211ull;
+}
+
+struct ResultItem {
+    string name = "";
+    variant<string, vector<ResultItem>> value;
+    // Hash of the name and the whole value, or 0 when it was not computed.
+    // With subtreeHashes on it is computed bottom-up as the tree is built,
+    // so identical subtrees can be found without comparing them node by
+    // node.
+    size_t hash = 0;
+
+    static ResultItem make(string name, variant<string, vector<ResultItem>> value) {
+        ResultItem item {std::move(name), std::move(value)};
+        if (subtreeHashes) {
+            item.hash = hashOf(item);
+        }
+        return item;
+    }
+
+    // The hash of `item` from its name, its value and its children's hashes.
+    static size_t hashOf(const ResultItem& item) {
+        auto hash = mixHash(hashBasis, std::hash<string>()(item.name));
+        if (item.value.index() == 0) {
+            hash = mixHash(hash, std::hash<string>()(std::get<0>(item.value)));
+        } else {
+            for (auto& child : std::get<1>(item.value)) {
+                hash = mixHash(hash, child.hash);
+            }
+        }
+        return hash;
+    }
+};
+
+using ResultMap = vector<ResultItem>;
+
+enum class ResultType {
+    Success = 1,
+    Failure = 2
+};
+
+struct Result {
+    ResultType status;
+    string_view matched;
+    string_view rest;
+    string error;
+    ResultMap results;
+
+    Result() {}
+    Result(ResultType status, string_view matched, string_view rest, string error):
+        status(status),
+        matched(matched),
+        rest(rest),
+        error(std::move(error)) {
+    }
+
+    static Result failure(string error) {
+        return Result(ResultType::Failure, "", "", std::move(error));
+    }
+
+    static Result success(string_view matched, string_view rest) {
+        return Result(ResultType::Success, matched, rest, "");
+    }
+
+    bool isFailure() const { return status == ResultType::Failure; }
+    bool isSuccess() const { return status == ResultType::Success; }
+
+    void add(string name, string_view value) {
+        if (value.size() > 0) {
+            results.push_back(ResultItem::make(std::move(name), string(value)));
+        }
+    }
+    void add(string name, ResultMap value) {
+        results.push_back(ResultItem::make(std::move(name), std::move(value)));
+    }
+
+    void combine(Result&& result) {
+        for(auto &item : result.results) {
+            this->results.push_back(std::move(item));
+        }
+    }
+};
+
+std::ostream &operator <<(std::ostream &o, const Result &result)
+{
+    o << "\n";
+    o << "[  Result  ]\n";
+    o << "===========================================\n";
+    if (result.isFailure()) {
+        o << "{\n Result: Failure,\n Error: " << result.error << "\n}\n";
+    } else {
+        o << "{\n Result: Success,\n Matched: " << result.matched <<  ",\n Rest: " << result.rest << "\n}\n";
+        o << "\n";
+
+        o << "[  AST  ]\n";
+        o << "===========================================\n";
+
+        std::function<void(const ResultMap&, int)> printVector;
+        printVector = [&o, &printVector](const ResultMap& items, int level) -> void {
+            for (auto &item : items) {
+                if (item.value.index() == 0) {
+                    o << std::string(level * 4, ' ') << item.name << ": \"" << std::get<0>(item.value) << "\" \n";
+                } else {
+                    o << std::string(level * 4, ' ') << item.name << ": {" << "\n";
+                    printVector(std::get<1>(item.value), level + 1);
+                    o << std::string(level * 4, ' ') << "}" << "\n";
+                }
+            }
+        };
+
+        printVector(result.results, 0);
+        o << "===========================================\n";
+    }
+    return o;
+}
+
+using Parser = std::function<Result(string_view)>;
+
+// Number of combinator invocations made on the current thread. Tools reset it
+// before a parse and read it afterwards to measure how much work an input cost.
+inline thread_local size_t combinatorSteps = 0;
+
+// Set on the current thread whenever a parser looks for input past the end
+// of its source. A parse that leaves it clear would give the same result on
+// any longer input, which is how streaming readers know a result is final.
+inline thread_local bool sawEndOfInput = false;
+
+// Notified around every named rule (every mapTo) parsed on the current thread
+// while installed in ruleObserver. Profilers and tracers hook in here; when no
+// observer is installed the cost is a single thread-local load per rule.
+struct RuleObserver {
+    virtual ~RuleObserver() {}
+    virtual void enter(const string& rule, string_view source) = 0;
+    virtual void exit(const string& rule, const Result& result) = 0;
+
+    // Around every attempt the parse may backtrack over: the first branch
+    // of a choice, each repetition of many, a lookahead. Ended with true
+    // when it was backtracked over, so the rules that matched inside it are
+    // not part of the result and observers that build on them forget them.
+    virtual void beginAttempt() {}
+    virtual void endAttempt(bool) {}
+};
+
+inline thread_local RuleObserver* ruleObserver = nullptr;
+
+// Runs `parser` as an attempt the caller backtracks over if it fails.
+Result attempt(const Parser& parser, string_view source) {
+    auto observer = ruleObserver;
+    if (observer == nullptr) {
+        return parser(source);
+    }
+    observer->beginAttempt();
+    auto result = parser(source);
+    observer->endAttempt(result.isFailure());
+    return result;
+}
+
+// How named results are shaped as they are built. The default keeps every
+// wrapper, which is the shape the printer and the tools expect.
+struct AstShape {
+    // A named node whose only child is a leaf becomes a leaf with that
+    // value, so `left: { MulExpression: { left: "a" } }` is `left: "a"`.
+    bool elideWrappers = false;
+    // An "item" around a single node is dropped and the node kept in its
+    // place; items holding several results stay.
+    bool flattenItems = false;
+};
+
+// Shape applied on the current thread; set it for a whole parse, or use
+// shaped() for the rules below one rule.
+inline thread_local AstShape astShape;
+
+// The node an "item" wrapper with a single child stands for - the node
+// flattenItems keeps in its place - so consumers can read results of
+// either shape the same way.
+const ResultItem& unwrapped(const ResultItem& item) {
+    if (item.name == "item" && item.value.index() == 1 && std::get<1>(item.value).size() == 1) {
+        return unwrapped(std::get<1>(item.value).front());
+    }
+    return item;
+}
+
+// 64-bit FNV-1a, for fingerprints and file names that must be stable
+// across runs and builds.
+uint64_t fnv1a(string_view data, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char ch : data) {
+        hash = (hash ^ ch) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// The part of `source` a parser consumed, given the rest it left over. Every
+// parser returns a prefix of its input, so this never copies.
+string_view consumed(string_view source, string_view rest) {
+    return source.substr(0, source.size() - rest.size());
+}
+
+// The combinators below are function objects of named types rather than
+// lambdas, so analyses such as predictive.h can look inside a Parser with
+// target<>().
+
+struct CharParser {
+    char ch;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        if (source.length() == 0) {
+            sawEndOfInput = true;
+            return Result::failure("End of imput stream.");
+        }
+
+        auto firstChar = source[0];
+
+        if (firstChar == ch) {
+            return Result::success(source.substr(0, 1), source.substr(1));
+        } else {
+            stringstream error;
+            error << "Expected '" << ch << "' but got '" << firstChar << "'";
+            return Result::failure(error.str());
+        }
+    }
+};
+
+Parser parseChar(char ch) {
+    return CharParser{ch};
+}
+
+struct AndThenParser {
+    Parser parser1;
+    Parser parser2;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+
+        auto result1 = parser1(source);
+
+        if (result1.isFailure()) {
+            return result1;
+        }
+
+        auto result2 = parser2(result1.rest);
+
+        if (result2.isFailure()) {
+            return result2;
+        } else {
+            auto result = Result::success(consumed(source, result2.rest), result2.rest);
+
+            result.combine(std::move(result1));
+            result.combine(std::move(result2));
+            return result;
+        }
+    }
+};
+
+Parser andThen (Parser parser1, Parser parser2) {
+    return AndThenParser{parser1, parser2};
+}
+
+struct OrElseParser {
+    Parser parser1;
+    Parser parser2;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+
+        auto result1 = attempt(parser1, source);
+
+        if (result1.isSuccess()) {
+            return result1;
+        }
+
+        auto result2 = parser2(source);
+        return result2;
+    }
+};
+
+Parser orElse(Parser parser1, Parser parser2) {
+    return OrElseParser{parser1, parser2};
+}
+
+Parser reduce(vector<Parser> parsers, std::function<Parser(Parser, Parser)> reducer) {
+    auto result = parsers[0];
+    for (int i = 1; i < parsers.size(); i++) {
+        result = reducer(result, parsers[i]);
+    }
+    return result;
+};
+
+template <typename TInput, typename Mapper>
+vector<Parser> mapWith(TInput source, Mapper mapper) {
+    vector<Parser> result;
+    for(auto e: source) {
+        result.push_back(mapper(e));
+    }
+    return result;
+}
+
+Parser choice(vector<Parser> parsers) {
+    return reduce(parsers, orElse);
+}
+
+Parser anyOf(string value) {
+    return choice(mapWith(value, parseChar));
+}
+
+Parser anyOf(char start, char end) {
+    vector<Parser> parsers;
+    for (char ch = start; ch <= end; ch++) {
+        parsers.push_back(parseChar(ch));
+    }
+    return choice(parsers);
+}
+
+Parser parseString(string value) {
+    return reduce(mapWith(value, parseChar), andThen);
+}
+
+Parser sequence(vector<Parser> parsers) {
+    return reduce(parsers, andThen);
+}
+
+struct NullParser {
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        return Result::success(source.substr(0, 0), source);
+    }
+};
+
+Parser nullParser() {
+    return NullParser{};
+}
+
+Parser opt(Parser parser) {
+    return choice({parser, nullParser()});
+}
+
+struct ManyParser {
+    Parser parser;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        string_view input = source;
+        ResultMap items;
+
+        while (true) {
+            auto result = attempt(parser, input);
+            if (result.isFailure()) {
+                auto result = Result::success(consumed(source, input), input);
+                result.results = std::move(items);
+                return result;
+            } else {
+                input = result.rest;
+
+                if (result.results.size() == 1 && astShape.flattenItems) {
+                    items.push_back(std::move(result.results[0]));
+                } else if (result.results.size() > 0) {
+                    items.push_back(ResultItem::make("item", std::move(result.results)));
+                }
+            }
+        }
+    }
+};
+
+Parser many(Parser parser) {
+    return ManyParser{parser};
+}
+
+struct Many1Parser {
+    Parser parser;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        string_view input = source;
+
+        while (true) {
+            auto result = attempt(parser, input);
+            if (result.isFailure()) {
+                if (input.size() == source.size()) {
+                    return result;
+                }
+                auto result = Result::success(consumed(source, input), input);
+                return result;
+            } else {
+                input = result.rest;
+            }
+        }
+    }
+};
+
+Parser many1(Parser parser) {
+    return Many1Parser{parser};
+}
+
+Parser takeLeft (Parser parser1, Parser parser2) {
+    return [parser1, parser2](string_view source) -> Result {
+        combinatorSteps++;
+        auto result1 = parser1(source);
+        auto result2 = parser1(result1.rest);
+        return result2;
+    };
+}
+
+Result nameResult(Result result, const string& name) {
+    if (result.isSuccess()) {
+        if (result.results.size() == 0) {
+            result.add(name, result.matched);
+        } else if (result.results.size() == 1 && astShape.flattenItems && name == "item") {
+            return result;
+        } else if (result.results.size() == 1 && astShape.elideWrappers && result.results[0].value.index() == 0) {
+            auto value = std::move(std::get<0>(result.results[0].value));
+            result.results.clear();
+            result.results.push_back(ResultItem::make(name, std::move(value)));
+        } else {
+            auto newResults = Result::success(result.matched, result.rest);
+            newResults.add(name, std::move(result.results));
+            return newResults;
+        }
+    }
+    return result;
+}
+
+struct MapToParser {
+    Parser parser;
+    string name;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        auto observer = ruleObserver;
+        if (observer == nullptr) {
+            return nameResult(parser(source), name);
+        }
+
+        observer->enter(name, source);
+        auto result = nameResult(parser(source), name);
+        observer->exit(name, result);
+        return result;
+    }
+};
+
+Parser mapTo(Parser parser, string name) {
+    return MapToParser{parser, name};
+}
+
+struct ShapedParser {
+    Parser parser;
+    AstShape shape;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        auto savedShape = astShape;
+        astShape = shape;
+        auto result = parser(source);
+        astShape = savedShape;
+        return result;
+    }
+};
+
+// `parser` with its results shaped by `shape`, whatever the shape of the
+// rules around it.
+Parser shaped(Parser parser, AstShape shape) {
+    return ShapedParser{parser, shape};
+}
+
+Parser listOf(Parser whiteSpace, Parser parser, char separator) {
+
+    auto separatorParser = parseChar(separator);
+
+    return sequence({
+        mapTo(
+            opt(
+                sequence({whiteSpace, parser})
+            ),
+            "item"
+        ),
+        many(
+            sequence({
+                whiteSpace, separatorParser,
+                whiteSpace, parser
+            })
+        )
+    });
+}
+
+struct RefParser {
+    Parser* reference;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        auto result = (*reference)(source);
+        return result;
+    }
+};
+
+Parser refParser(Parser &reference) {
+    return RefParser{&reference};
+};
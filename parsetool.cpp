@@ -0,0 +1,323 @@
+// Command-line driver: parses files and directory trees with the grammar.
+//
+//     parsetool [options] <file-or-directory>...
+//
+//     -j, --threads N       parse with N threads (default: all cores)
+//     --validate-only       only report files that do not parse
+//     --format F            text (default), json or binary
+//     --ext .E              in directories, only parse files ending in .E
+//     --stats               print throughput, allocations, per-rule
+//                           timings and predictive choices to stderr
+//
+// Directories are searched recursively and files are parsed in sorted path
+// order; results are written to stdout in that order, each as soon as it
+// and every file before it are done. Workers stay at most a few files per
+// thread ahead of the output, so only those files' output is held in
+// memory. With --stats every rule is profiled, so the reported throughput
+// is that of an instrumented parse. A file parses when
+// `parse` consumes everything but trailing white space. The exit status is
+// 0 when every file parsed, 1 when some did not and 2 on usage or I/O
+// errors.
+//
+// The binary format is the magic "PAR1", the number of files, and per file
+// its path, a status byte (0 parsed, 1 failed), the error and the result
+// tree as written by writeBinaryTree().
+
+#include "alloc_counter.h"
+#include "ast_format.h"
+#include "grammar.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+enum class OutputFormat {
+    Text,
+    Json,
+    Binary
+};
+
+struct Options {
+    size_t threads = max(1u, thread::hardware_concurrency());
+    bool validateOnly = false;
+    OutputFormat format = OutputFormat::Text;
+    string extension;
+    bool stats = false;
+    vector<string> paths;
+};
+
+struct FileResult {
+    bool readable = false;
+    bool parsed = false;
+    string error;
+    size_t bytes = 0;
+    // The file's formatted output, released once it is written.
+    string output;
+    // Set under the output lock when the fields above are final.
+    bool done = false;
+};
+
+void usage() {
+    cerr << "usage: parsetool [-j N] [--validate-only] [--format text|json|binary] [--ext .E] [--stats]"
+            " <file-or-directory>...\n";
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        auto value = [&]() -> string {
+            return i + 1 < argc ? argv[++i] : "";
+        };
+
+        if (arg == "-j" || arg == "--threads") {
+            auto count = atoi(value().c_str());
+            if (count < 1) {
+                return false;
+            }
+            options.threads = count;
+        } else if (arg == "--validate-only") {
+            options.validateOnly = true;
+        } else if (arg == "--format") {
+            auto format = value();
+            if (format == "text") {
+                options.format = OutputFormat::Text;
+            } else if (format == "json") {
+                options.format = OutputFormat::Json;
+            } else if (format == "binary") {
+                options.format = OutputFormat::Binary;
+            } else {
+                return false;
+            }
+        } else if (arg == "--ext") {
+            options.extension = value();
+        } else if (arg == "--stats") {
+            options.stats = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            return false;
+        } else {
+            options.paths.push_back(arg);
+        }
+    }
+    return !options.paths.empty();
+}
+
+bool collectFiles(const Options& options, vector<string>& files) {
+    for (auto& path : options.paths) {
+        error_code error;
+        if (filesystem::is_directory(path, error)) {
+            for (auto& entry : filesystem::recursive_directory_iterator(path, error)) {
+                auto name = entry.path().string();
+                if (entry.is_regular_file() &&
+                    (options.extension.empty() || entry.path().extension() == options.extension)) {
+                    files.push_back(name);
+                }
+            }
+        } else if (filesystem::is_regular_file(path, error)) {
+            files.push_back(path);
+        } else {
+            cerr << "parsetool: cannot read " << path << "\n";
+            return false;
+        }
+        if (error) {
+            cerr << "parsetool: " << path << ": " << error.message() << "\n";
+            return false;
+        }
+    }
+    sort(files.begin(), files.end());
+    return true;
+}
+
+// "line:column" of `position` within `source`, both counted from 1.
+string location(string_view source, string_view position) {
+    auto offset = position.data() - source.data();
+    size_t line = 1, column = 1;
+    for (ptrdiff_t i = 0; i < offset; i++) {
+        if (source[i] == '\n') {
+            line++;
+            column = 1;
+        } else {
+            column++;
+        }
+    }
+    return to_string(line) + ":" + to_string(column);
+}
+
+void parseFile(const string& path, const Options& options, FileResult& file) {
+    ifstream in(path, ios::binary);
+    stringstream content;
+    content << in.rdbuf();
+    file.readable = in.is_open() && !in.bad();
+
+    auto source = content.str();
+    file.bytes = source.size();
+    auto result = file.readable ? parse(source) : Result::failure("cannot read file");
+
+    auto rest = result.rest;
+    rest.remove_prefix(min(rest.find_first_not_of(" \t\r\n"), rest.size()));
+    if (result.isFailure()) {
+        file.error = result.error;
+    } else if (!rest.empty()) {
+        file.error = location(source, rest) + ": unexpected input";
+    } else {
+        file.parsed = true;
+    }
+
+    stringstream out;
+    if (options.validateOnly) {
+        if (!file.parsed) {
+            out << path << ": " << file.error << "\n";
+        }
+    } else if (options.format == OutputFormat::Text) {
+        out << "== " << path << " ==\n";
+        if (file.parsed) {
+            out << result;
+        } else {
+            out << "error: " << file.error << "\n";
+        }
+    } else if (options.format == OutputFormat::Json) {
+        out << "{\"path\":";
+        writeJsonString(out, path);
+        out << ",\"parsed\":" << (file.parsed ? "true" : "false");
+        if (!file.parsed) {
+            out << ",\"error\":";
+            writeJsonString(out, file.error);
+        }
+        out << ",\"ast\":";
+        writeJson(out, result.results);
+        out << "}";
+    } else {
+        using namespace replay_format;
+        writeString(out, path);
+        out.put(char(file.parsed ? 0 : 1));
+        writeString(out, file.error);
+        writeBinaryTree(out, result.results);
+    }
+    file.output = out.str();
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    vector<string> files;
+    if (!collectFiles(options, files)) {
+        return 2;
+    }
+
+    vector<FileResult> results(files.size());
+    auto threads = min(options.threads, max<size_t>(1, files.size()));
+    vector<unique_ptr<RuleProfiler>> profilers;
+    for (size_t i = 0; i < threads; i++) {
+        profilers.push_back(make_unique<RuleProfiler>());
+    }
+
+    atomic<size_t> next{0};
+    atomic<size_t> allocations{0};
+    // Files written so far; workers do not start a file more than `window`
+    // past it.
+    mutex outputLock;
+    condition_variable outputChanged;
+    size_t written = 0;
+    auto window = 4 * threads;
+    auto start = chrono::steady_clock::now();
+
+    vector<thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            if (options.stats) {
+                ruleObserver = profilers[t].get();
+            }
+            auto allocationsBefore = allocationCount;
+            for (auto index = next++; index < files.size(); index = next++) {
+                {
+                    unique_lock<mutex> lock(outputLock);
+                    outputChanged.wait(lock, [&]() { return index < written + window; });
+                }
+                FileResult file;
+                parseFile(files[index], options, file);
+                {
+                    lock_guard<mutex> lock(outputLock);
+                    results[index] = std::move(file);
+                    results[index].done = true;
+                }
+                outputChanged.notify_all();
+            }
+            allocations += allocationCount - allocationsBefore;
+            ruleObserver = nullptr;
+        });
+    }
+
+    if (!options.validateOnly && options.format == OutputFormat::Binary) {
+        cout.write("PAR1", 4);
+        replay_format::writeVarint(cout, files.size());
+    } else if (!options.validateOnly && options.format == OutputFormat::Json) {
+        cout << "[";
+    }
+    size_t failed = 0, unreadable = 0, bytes = 0;
+    for (size_t i = 0; i < results.size(); i++) {
+        auto& file = results[i];
+        {
+            unique_lock<mutex> lock(outputLock);
+            outputChanged.wait(lock, [&]() { return file.done; });
+        }
+        if (!options.validateOnly && options.format == OutputFormat::Json && i > 0) {
+            cout << ",";
+        }
+        cout << file.output;
+        string().swap(file.output);
+        {
+            lock_guard<mutex> lock(outputLock);
+            written = i + 1;
+        }
+        outputChanged.notify_all();
+        if (!file.readable) {
+            cerr << "parsetool: " << files[i] << ": " << file.error << "\n";
+            unreadable++;
+        } else if (!file.parsed) {
+            failed++;
+        }
+        bytes += file.bytes;
+    }
+    if (!options.validateOnly && options.format == OutputFormat::Json) {
+        cout << "]\n";
+    }
+    cout.flush();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (options.stats) {
+        cerr << files.size() << " files, " << bytes << " bytes, " << failed << " failed, "
+             << unreadable << " unreadable, " << threads << " threads\n";
+        cerr << fixed << setprecision(3) << seconds << " s, "
+             << setprecision(2) << bytes / seconds / 1e6 << " MB/s, "
+             << files.size() / seconds << " files/s, profiled and including output\n";
+        cerr << allocations.load() << " allocations, "
+             << setprecision(1) << double(allocations.load()) / max<size_t>(1, files.size()) << " per file\n";
+
+        RuleProfiler merged;
+        for (auto& profiler : profilers) {
+            merged.merge(*profiler);
+        }
+        merged.report(cerr);
+        reportPredictive(cerr);
+    }
+
+    if (unreadable > 0) {
+        return 2;
+    }
+    return failed > 0 ? 1 : 0;
+}
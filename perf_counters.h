@@ -0,0 +1,129 @@
+#pragma once
+
+// Hardware performance counters for the calling thread, read through Linux
+// perf_event_open. All counters live in one event group so a single read()
+// returns a consistent snapshot. When the kernel refuses (no PMU in a VM,
+// perf_event_paranoid, seccomp) or on other platforms, available() is false
+// and every reading is zero.
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <cerrno>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+enum PerfCounter {
+    Cycles = 0,
+    Instructions,
+    BranchMisses,
+    CacheMisses,
+    PerfCounterCount
+};
+
+const char* const perfCounterNames[PerfCounterCount] = {
+    "cycles", "instructions", "branch-misses", "cache-misses"
+};
+
+using PerfReading = std::array<uint64_t, PerfCounterCount>;
+
+class PerfCounters {
+public:
+    PerfCounters() {
+#ifdef __linux__
+        const uint64_t configs[PerfCounterCount] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_MISSES
+        };
+
+        for (int counter = 0; counter < PerfCounterCount; counter++) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[counter];
+            attr.disabled = leader < 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            int fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+            if (fd < 0) {
+                if (leader < 0) {
+                    error = std::string("perf_event_open: ") + strerror(errno);
+                    return;
+                }
+                continue;
+            }
+
+            if (leader < 0) {
+                leader = fd;
+            }
+            fds[counter] = fd;
+            slots[counter] = opened++;
+        }
+
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+        error = "perf_event_open is only available on Linux";
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (auto fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    bool available() const { return leader >= 0; }
+
+    // Whether this particular counter could be opened. The CPU may support
+    // cycles and instructions but not, say, cache misses.
+    bool available(PerfCounter counter) const { return fds[counter] >= 0; }
+
+    const std::string& unavailableReason() const { return error; }
+
+    PerfReading read() const {
+        PerfReading reading{};
+#ifdef __linux__
+        if (leader < 0) {
+            return reading;
+        }
+
+        uint64_t buffer[1 + PerfCounterCount];
+        if (::read(leader, buffer, sizeof(buffer)) <= 0) {
+            return reading;
+        }
+
+        for (int counter = 0; counter < PerfCounterCount; counter++) {
+            if (slots[counter] >= 0 && uint64_t(slots[counter]) < buffer[0]) {
+                reading[counter] = buffer[1 + slots[counter]];
+            }
+        }
+#endif
+        return reading;
+    }
+
+private:
+    int leader = -1;
+    int opened = 0;
+    std::array<int, PerfCounterCount> fds{-1, -1, -1, -1};
+    std::array<int, PerfCounterCount> slots{-1, -1, -1, -1};
+    std::string error;
+};
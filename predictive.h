@@ -0,0 +1,448 @@
+#pragma once
+
+// Predictive execution of ordered choices.
+//
+// choice() tries its alternatives one after another, and every alternative
+// that fails first reparses the input its predecessor already looked at.
+// predictive() is an ordered choice that looks at the next character first:
+// on its first use it computes the FIRST set of every alternative - the
+// characters it can start with - and builds a table from each character to
+// the alternatives that can succeed there. Where only one alternative can,
+// it is run directly and nothing is retried; the choice is LL(1) when that
+// holds for every character. Where several can, they are tried in order, as
+// choice() would, so only those characters pay for backtracking.
+//
+// Most alternatives start with the same white space skip, so when they all
+// do, the table is indexed by the first character after that skip instead.
+// FIRST sets are read from the structure of the combinators in parser.h and
+// jit.h; a parser of any other type is assumed to start with anything, which
+// keeps the table correct but makes it less selective.
+//
+// Results, errors and sawEndOfInput are those of choice(). Rule observers
+// only see the alternatives that are run.
+
+#include "jit.h"
+
+#include <algorithm>
+#include <bitset>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+
+// Set to false to run predictive choices as ordered choices, for example to
+// compare the two.
+inline thread_local bool predictiveParsing = true;
+
+struct FirstSet {
+    bitset<256> chars;
+    // Whether the parser can succeed without consuming anything.
+    bool nullable = false;
+};
+
+struct PredictiveChoice;
+
+// Computes FIRST sets, iterating to a fixed point through refParser() so that
+// recursive rules are handled.
+class FirstSetAnalysis {
+public:
+    FirstSet of(const Parser& parser) {
+        return solve([&]() { return first(parser); });
+    }
+
+    // FIRST of what follows the greedy skip of `skip` that `parser` starts
+    // with, or nothing when it does not start with one.
+    optional<FirstSet> afterSkip(const Parser& parser, const bitset<256>& skip) {
+        optional<FirstSet> result;
+        solve([&]() {
+            result = skipped(parser, skip);
+            return FirstSet{};
+        });
+        return result;
+    }
+
+    // Characters of the greedy skip `parser` starts with, if any.
+    static optional<bitset<256>> leadingSkip(const Parser& parser);
+
+private:
+    map<const Parser*, FirstSet> rules;
+    set<const Parser*> visited;
+    bool changed = false;
+
+    template <typename Body>
+    FirstSet solve(Body body) {
+        FirstSet result;
+        do {
+            changed = false;
+            visited.clear();
+            result = body();
+        } while (changed);
+        return result;
+    }
+
+    static FirstSet anything() {
+        FirstSet result;
+        result.chars.set();
+        result.nullable = true;
+        return result;
+    }
+
+    // FIRST of `head` followed by `next`.
+    FirstSet then(FirstSet head, const Parser& next) {
+        if (!head.nullable) {
+            return head;
+        }
+        auto result = first(next);
+        result.chars |= head.chars;
+        return result;
+    }
+
+    FirstSet rule(const Parser* reference) {
+        auto found = rules.find(reference);
+        if (found != rules.end() && visited.count(reference)) {
+            return found->second;
+        }
+        visited.insert(reference);
+        rules.emplace(reference, FirstSet{});
+
+        auto result = first(*reference);
+        auto& known = rules[reference];
+        if (result.chars != known.chars || result.nullable != known.nullable) {
+            known = result;
+            changed = true;
+        }
+        return result;
+    }
+
+    static FirstSet programFirst(const ScanProgram& program) {
+        FirstSet result;
+        for (auto& step : program) {
+            for (int ch = 0; ch < 256; ch++) {
+                if (step.chars[ch / 64] & (uint64_t(1) << (ch % 64))) {
+                    result.chars.set(ch);
+                }
+            }
+            if (step.required) {
+                return result;
+            }
+        }
+        result.nullable = true;
+        return result;
+    }
+
+    // The characters `parser` matches when it matches exactly one of them.
+    static optional<bitset<256>> singleChar(const Parser& parser) {
+        if (auto p = parser.target<CharParser>()) {
+            bitset<256> chars;
+            chars.set((unsigned char)p->ch);
+            return chars;
+        }
+        if (auto p = parser.target<OrElseParser>()) {
+            auto a = singleChar(p->parser1);
+            auto b = singleChar(p->parser2);
+            if (a && b) {
+                return *a | *b;
+            }
+        }
+        if (auto p = parser.target<CompiledRuleParser>()) {
+            if (p->program.size() == 1 && p->program[0].required && !p->program[0].repeat) {
+                return programFirst(p->program).chars;
+            }
+        }
+        return nullopt;
+    }
+
+    // The characters of `parser` when it is a greedy skip, many(c) or
+    // opt(many(c)) for a set of single characters c.
+    static optional<bitset<256>> skipChars(const Parser& parser) {
+        if (auto p = parser.target<ManyParser>()) {
+            return singleChar(p->parser);
+        }
+        if (auto p = parser.target<OrElseParser>()) {
+            if (p->parser2.target<NullParser>()) {
+                return skipChars(p->parser1);
+            }
+        }
+        if (auto p = parser.target<CompiledRuleParser>()) {
+            if (p->program.size() == 1 && !p->program[0].required && p->program[0].repeat) {
+                return programFirst(p->program).chars;
+            }
+        }
+        return nullopt;
+    }
+
+    optional<FirstSet> skipped(const Parser& parser, const bitset<256>& skip) {
+        if (auto chars = skipChars(parser)) {
+            if (*chars != skip) {
+                return nullopt;
+            }
+            FirstSet empty;
+            empty.nullable = true;
+            return empty;
+        }
+        if (auto p = parser.target<AndThenParser>()) {
+            auto head = skipped(p->parser1, skip);
+            if (!head) {
+                return nullopt;
+            }
+            return then(*head, p->parser2);
+        }
+        if (auto p = parser.target<MapToParser>()) {
+            return skipped(p->parser, skip);
+        }
+        if (auto p = parser.target<ShapedParser>()) {
+            return skipped(p->parser, skip);
+        }
+        return nullopt;
+    }
+
+    FirstSet first(const Parser& parser);
+};
+
+// The table a predictive choice runs from.
+struct PredictiveTable {
+    // Characters skipped before looking up the next one.
+    bitset<256> skip;
+    // Per next character, and for the end of the input at 256, an index
+    // into `candidates`: the alternatives that can succeed there, in order.
+    array<size_t, 257> row{};
+    vector<vector<size_t>> candidates;
+
+    // Whether no character has more than one candidate.
+    bool isLL1() const {
+        for (auto& list : candidates) {
+            if (list.size() > 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+PredictiveTable buildPredictiveTable(const vector<Parser>& alternatives) {
+    FirstSetAnalysis analysis;
+    PredictiveTable table;
+    vector<FirstSet> firstSets;
+
+    auto skip = FirstSetAnalysis::leadingSkip(alternatives[0]);
+    if (skip) {
+        for (auto& alternative : alternatives) {
+            auto after = analysis.afterSkip(alternative, *skip);
+            if (!after) {
+                skip.reset();
+                firstSets.clear();
+                break;
+            }
+            firstSets.push_back(*after);
+        }
+    }
+    if (!skip) {
+        for (auto& alternative : alternatives) {
+            firstSets.push_back(analysis.of(alternative));
+        }
+    } else {
+        table.skip = *skip;
+    }
+
+    map<vector<size_t>, size_t> known;
+    for (size_t key = 0; key <= 256; key++) {
+        vector<size_t> list;
+        for (size_t i = 0; i < firstSets.size(); i++) {
+            if (firstSets[i].nullable || (key < 256 && firstSets[i].chars[key])) {
+                list.push_back(i);
+            }
+        }
+        auto found = known.emplace(list, table.candidates.size());
+        if (found.second) {
+            table.candidates.push_back(list);
+        }
+        table.row[key] = found.first->second;
+    }
+    return table;
+}
+
+struct PredictiveChoice {
+    struct State {
+        string name;
+        vector<Parser> alternatives;
+        once_flag built;
+        PredictiveTable table;
+
+        const PredictiveTable& get() {
+            call_once(built, [this]() { table = buildPredictiveTable(alternatives); });
+            return table;
+        }
+    };
+
+    shared_ptr<State> state;
+
+    Result operator()(string_view source) const {
+        combinatorSteps++;
+        auto& alternatives = state->alternatives;
+
+        if (!predictiveParsing) {
+            for (size_t i = 0; i + 1 < alternatives.size(); i++) {
+                auto result = attempt(alternatives[i], source);
+                if (result.isSuccess()) {
+                    return result;
+                }
+            }
+            return alternatives.back()(source);
+        }
+
+        auto& table = state->get();
+        size_t position = 0;
+        while (position < source.size() && table.skip[(unsigned char)source[position]]) {
+            position++;
+        }
+        size_t key = 256;
+        if (position < source.size()) {
+            key = (unsigned char)source[position];
+        } else {
+            sawEndOfInput = true;
+        }
+
+        for (auto index : table.candidates[table.row[key]]) {
+            auto result = attempt(alternatives[index], source);
+            if (result.isSuccess() || index + 1 == alternatives.size()) {
+                return result;
+            }
+        }
+        // The error an ordered choice reports is that of its last alternative.
+        return alternatives.back()(source);
+    }
+};
+
+optional<bitset<256>> FirstSetAnalysis::leadingSkip(const Parser& parser) {
+    if (auto chars = skipChars(parser)) {
+        return chars;
+    }
+    if (auto p = parser.target<AndThenParser>()) {
+        return leadingSkip(p->parser1);
+    }
+    if (auto p = parser.target<MapToParser>()) {
+        return leadingSkip(p->parser);
+    }
+    if (auto p = parser.target<ShapedParser>()) {
+        return leadingSkip(p->parser);
+    }
+    return nullopt;
+}
+
+FirstSet FirstSetAnalysis::first(const Parser& parser) {
+    if (!parser) {
+        return anything();
+    }
+    if (auto p = parser.target<CharParser>()) {
+        FirstSet result;
+        result.chars.set((unsigned char)p->ch);
+        return result;
+    }
+    if (auto p = parser.target<AndThenParser>()) {
+        return then(first(p->parser1), p->parser2);
+    }
+    if (auto p = parser.target<OrElseParser>()) {
+        auto result = first(p->parser1);
+        auto second = first(p->parser2);
+        result.chars |= second.chars;
+        result.nullable |= second.nullable;
+        return result;
+    }
+    if (parser.target<NullParser>()) {
+        FirstSet result;
+        result.nullable = true;
+        return result;
+    }
+    if (auto p = parser.target<ManyParser>()) {
+        auto result = first(p->parser);
+        result.nullable = true;
+        return result;
+    }
+    if (auto p = parser.target<Many1Parser>()) {
+        return first(p->parser);
+    }
+    if (auto p = parser.target<MapToParser>()) {
+        return first(p->parser);
+    }
+    if (auto p = parser.target<ShapedParser>()) {
+        return first(p->parser);
+    }
+    if (auto p = parser.target<RefParser>()) {
+        return rule(p->reference);
+    }
+    if (auto p = parser.target<CompiledRuleParser>()) {
+        return programFirst(p->program);
+    }
+    if (auto p = parser.target<PredictiveChoice>()) {
+        FirstSet result;
+        for (auto& alternative : p->state->alternatives) {
+            auto next = first(alternative);
+            result.chars |= next.chars;
+            result.nullable |= next.nullable;
+        }
+        return result;
+    }
+    return anything();
+}
+
+// The predictive choices that still exist, for reports. Grammars built at
+// run time come and go, so the list does not keep them alive.
+inline vector<weak_ptr<PredictiveChoice::State>>& predictiveChoices() {
+    static vector<weak_ptr<PredictiveChoice::State>> choices;
+    return choices;
+}
+
+// Guards predictiveChoices(), as grammars may be built on any thread.
+inline mutex predictiveChoicesLock;
+
+// An ordered choice of `parsers` run from a table of their FIRST sets.
+// `name` identifies it in reports.
+Parser predictive(string name, vector<Parser> parsers) {
+    auto state = make_shared<PredictiveChoice::State>();
+    state->name = std::move(name);
+    state->alternatives = std::move(parsers);
+    lock_guard<mutex> lock(predictiveChoicesLock);
+    auto& choices = predictiveChoices();
+    choices.erase(remove_if(choices.begin(), choices.end(), [](auto& choice) { return choice.expired(); }),
+                  choices.end());
+    choices.push_back(state);
+    return PredictiveChoice{state};
+}
+
+string describeKey(size_t key) {
+    if (key == 256) {
+        return "end";
+    }
+    if (key > ' ' && key < 127) {
+        return string("'") + char(key) + "'";
+    }
+    stringstream out;
+    out << "0x" << hex << key;
+    return out.str();
+}
+
+// One line per predictive choice: LL(1), or the characters on which it
+// still tries more than one alternative.
+void reportPredictive(ostream& out) {
+    lock_guard<mutex> lock(predictiveChoicesLock);
+    for (auto& entry : predictiveChoices()) {
+        auto choice = entry.lock();
+        if (!choice) {
+            continue;
+        }
+        auto& table = choice->get();
+        out << choice->name << ": " << choice->alternatives.size() << " alternatives, ";
+        if (table.isLL1()) {
+            out << "LL(1)\n";
+            continue;
+        }
+        out << "backtracks on";
+        for (size_t key = 0; key <= 256; key++) {
+            if (table.candidates[table.row[key]].size() > 1) {
+                out << " " << describeKey(key);
+            }
+        }
+        out << "\n";
+    }
+}
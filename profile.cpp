@@ -0,0 +1,51 @@
+// Per-rule profile of a parse.
+//
+//     profile [--counters] [--repeat N] [file]
+//
+// --counters also reads cycles, instructions, branch misses and cache misses
+// around every named rule and reports IPC and misses per thousand
+// instructions. Without a file the sample program is parsed.
+
+#include "grammar.h"
+#include "profiler.h"
+#include "sample.h"
+
+#include <fstream>
+
+int main(int argc, char** argv) {
+    bool countHardwareEvents = false;
+    size_t repeat = 1;
+    string path;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--counters") {
+            countHardwareEvents = true;
+        } else if (arg == "--repeat" && i + 1 < argc) {
+            repeat = stoul(argv[++i]);
+        } else {
+            path = arg;
+        }
+    }
+
+    string source = sampleSource;
+    if (!path.empty()) {
+        ifstream file(path, ios::binary);
+        if (!file) {
+            cerr << "Cannot open " << path << "\n";
+            return 1;
+        }
+        stringstream content;
+        content << file.rdbuf();
+        source = content.str();
+    }
+
+    RuleProfiler profiler(countHardwareEvents);
+    ruleObserver = &profiler;
+    for (size_t i = 0; i < repeat; i++) {
+        parse(source);
+    }
+    ruleObserver = nullptr;
+
+    profiler.report(cout);
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+// Per-rule profiler. Installed as the thread's ruleObserver it records, for
+// every named rule, how often it ran, how often it failed, its wall time and
+// - when counting hardware events - cycles, instructions, branch misses and
+// cache misses. Inclusive figures cover everything below the rule; self
+// figures exclude nested named rules. Recursive rules are only counted
+// inclusively at their outermost activation.
+
+#include "parser.h"
+#include "perf_counters.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <unordered_map>
+
+struct RuleCost {
+    uint64_t nanoseconds = 0;
+    PerfReading counters{};
+
+    void add(const RuleCost& other) {
+        nanoseconds += other.nanoseconds;
+        for (int counter = 0; counter < PerfCounterCount; counter++) {
+            counters[counter] += other.counters[counter];
+        }
+    }
+
+    void subtract(const RuleCost& other) {
+        nanoseconds -= other.nanoseconds;
+        for (int counter = 0; counter < PerfCounterCount; counter++) {
+            counters[counter] -= other.counters[counter];
+        }
+    }
+};
+
+struct RuleProfile {
+    string name;
+    size_t calls = 0;
+    size_t failures = 0;
+    int active = 0;
+    RuleCost inclusive;
+    RuleCost self;
+};
+
+class RuleProfiler : public RuleObserver {
+public:
+    explicit RuleProfiler(bool countHardwareEvents = false) {
+        if (countHardwareEvents) {
+            counters = make_unique<PerfCounters>();
+        }
+    }
+
+    void enter(const string& rule, string_view) override {
+        auto& profile = rules[rule];
+        if (profile.name.empty()) {
+            profile.name = rule;
+        }
+        profile.calls++;
+        profile.active++;
+        stack.push_back(Frame{&profile, now(), RuleCost{}});
+    }
+
+    void exit(const string&, const Result& result) override {
+        auto frame = stack.back();
+        stack.pop_back();
+
+        auto elapsed = now();
+        elapsed.subtract(frame.start);
+
+        auto& profile = *frame.profile;
+        profile.active--;
+        if (result.isFailure()) {
+            profile.failures++;
+        }
+        if (profile.active == 0) {
+            profile.inclusive.add(elapsed);
+        }
+
+        auto self = elapsed;
+        self.subtract(frame.children);
+        profile.self.add(self);
+
+        if (!stack.empty()) {
+            stack.back().children.add(elapsed);
+        }
+    }
+
+    // Adds the figures of a profiler that observed another thread.
+    void merge(const RuleProfiler& other) {
+        for (auto& entry : other.rules) {
+            auto& profile = rules[entry.first];
+            profile.name = entry.first;
+            profile.calls += entry.second.calls;
+            profile.failures += entry.second.failures;
+            profile.inclusive.add(entry.second.inclusive);
+            profile.self.add(entry.second.self);
+        }
+    }
+
+    bool countsHardwareEvents() const { return counters && counters->available(); }
+
+    vector<RuleProfile> profiles() const {
+        vector<RuleProfile> result;
+        for (auto& entry : rules) {
+            result.push_back(entry.second);
+        }
+        sort(result.begin(), result.end(), [](const RuleProfile& a, const RuleProfile& b) {
+            return a.self.nanoseconds > b.self.nanoseconds;
+        });
+        return result;
+    }
+
+    void report(ostream& o) const {
+        if (counters && !counters->available()) {
+            o << "Hardware counters unavailable (" << counters->unavailableReason()
+              << "), reporting wall time only\n";
+        }
+
+        auto hardware = countsHardwareEvents();
+
+        o << left << setw(22) << "rule" << right
+          << setw(10) << "calls" << setw(10) << "failed"
+          << setw(12) << "self us" << setw(12) << "incl us";
+        if (hardware) {
+            o << setw(8) << "IPC" << setw(14) << "br-miss/kI" << setw(14) << "$-miss/kI";
+        }
+        o << "\n";
+
+        for (auto& profile : profiles()) {
+            o << left << setw(22) << profile.name << right
+              << setw(10) << profile.calls << setw(10) << profile.failures
+              << setw(12) << fixed << setprecision(1) << profile.self.nanoseconds / 1000.0
+              << setw(12) << profile.inclusive.nanoseconds / 1000.0;
+
+            if (hardware) {
+                auto& self = profile.self.counters;
+                o << setw(8) << setprecision(2) << ratio(self[Instructions], self[Cycles], 1, Cycles)
+                  << setw(14) << ratio(self[BranchMisses], self[Instructions], 1000, BranchMisses)
+                  << setw(14) << ratio(self[CacheMisses], self[Instructions], 1000, CacheMisses);
+            }
+            o << "\n";
+        }
+    }
+
+private:
+    struct Frame {
+        RuleProfile* profile;
+        RuleCost start;
+        RuleCost children;
+    };
+
+    RuleCost now() const {
+        RuleCost cost;
+        if (counters) {
+            cost.counters = counters->read();
+        }
+        cost.nanoseconds = chrono::duration_cast<chrono::nanoseconds>(
+            chrono::steady_clock::now().time_since_epoch()).count();
+        return cost;
+    }
+
+    // Misses per `scale` instructions; NaN when the counter was not opened.
+    double ratio(uint64_t count, uint64_t per, double scale, PerfCounter counter) const {
+        if (!counters->available(counter) || !counters->available(Instructions) || per == 0) {
+            return NAN;
+        }
+        return scale * double(count) / double(per);
+    }
+
+    unique_ptr<PerfCounters> counters;
+    unordered_map<string, RuleProfile> rules;
+    vector<Frame> stack;
+};
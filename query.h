@@ -0,0 +1,194 @@
+#pragma once
+
+// Indexed queries over a parse result.
+//
+// AstIndex flattens a ResultMap once into an array of nodes in document
+// order and keeps, for every node name, a posting list of the offsets of
+// the nodes with that name. Selectors are answered from those lists:
+//
+//     struct > function > parameters    a child of a child
+//     function parameter                a descendant
+//
+// The rightmost name picks the candidates from its posting list and only the
+// ancestors of each candidate are checked, so no query walks the tree.
+// The "item" wrappers added by many() and listOf() are transparent to
+// selectors: `parameters > parameter` matches through them.
+//
+// The index is built by one pass over the finished ResultMap rather than by
+// a RuleObserver during the parse. Observers also see rules that matched
+// inside alternatives that were later backtracked over, and must undo them
+// when told so through endAttempt(). They do not see the
+// "item" wrappers many() adds, and a node's place in the final tree is only
+// settled when the rules around it return. The pass is linear and costs
+// well under 1% of the parse.
+
+#include "parser.h"
+
+#include <unordered_map>
+
+struct FlatNode {
+    uint32_t name;
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    // Nearest ancestor that is not an "item" wrapper.
+    uint32_t logicalParent;
+    string value;
+};
+
+class AstIndex {
+public:
+    static const uint32_t none = UINT32_MAX;
+
+    explicit AstIndex(const ResultMap& results) {
+        itemName = intern("item");
+        add(results, none, none);
+    }
+
+    size_t size() const { return nodes.size(); }
+    const FlatNode& node(uint32_t index) const { return nodes[index]; }
+    const string& name(uint32_t index) const { return names[nodes[index].name]; }
+
+    // Offsets of all nodes called `name`, in document order.
+    const vector<uint32_t>& nodesNamed(const string& name) const {
+        static const vector<uint32_t> empty;
+        auto found = nameIds.find(name);
+        return found == nameIds.end() ? empty : postings[found->second];
+    }
+
+    // Value of the first direct child leaf called `name`, e.g. the name of a
+    // function node.
+    string childValue(uint32_t index, const string& name) const {
+        auto found = nameIds.find(name);
+        if (found == nameIds.end()) {
+            return "";
+        }
+        for (auto child = nodes[index].firstChild; child != none; child = nodes[child].nextSibling) {
+            if (nodes[child].name == found->second) {
+                return nodes[child].value;
+            }
+        }
+        return "";
+    }
+
+    vector<uint32_t> select(string_view selector) const {
+        auto steps = parseSelector(selector);
+        vector<uint32_t> matches;
+        if (steps.empty()) {
+            return matches;
+        }
+
+        for (auto candidate : nodesNamed(steps.back().name)) {
+            if (matchAncestors(steps, steps.size() - 1, candidate)) {
+                matches.push_back(candidate);
+            }
+        }
+        return matches;
+    }
+
+private:
+    struct Step {
+        string name;
+        // How this step relates to the one before it.
+        bool child;
+    };
+
+    uint32_t intern(const string& name) {
+        auto found = nameIds.find(name);
+        if (found != nameIds.end()) {
+            return found->second;
+        }
+        names.push_back(name);
+        postings.emplace_back();
+        return nameIds[name] = uint32_t(names.size() - 1);
+    }
+
+    void add(const ResultMap& items, uint32_t parent, uint32_t logicalParent) {
+        uint32_t previous = none;
+        for (auto& item : items) {
+            auto index = uint32_t(nodes.size());
+            auto name = intern(item.name);
+            nodes.push_back(FlatNode{name, parent, none, none, logicalParent, ""});
+            postings[name].push_back(index);
+
+            if (previous == none) {
+                if (parent != none) {
+                    nodes[parent].firstChild = index;
+                }
+            } else {
+                nodes[previous].nextSibling = index;
+            }
+            previous = index;
+
+            if (item.value.index() == 0) {
+                nodes[index].value = std::get<0>(item.value);
+            } else {
+                add(std::get<1>(item.value), index, name == itemName ? logicalParent : index);
+            }
+        }
+    }
+
+    static vector<Step> parseSelector(string_view selector) {
+        vector<Step> steps;
+        bool child = false;
+        size_t position = 0;
+
+        while (position < selector.size()) {
+            auto ch = selector[position];
+            if (ch == ' ' || ch == '\t') {
+                position++;
+            } else if (ch == '>') {
+                child = true;
+                position++;
+            } else {
+                auto end = selector.find_first_of(" \t>", position);
+                if (end == string_view::npos) {
+                    end = selector.size();
+                }
+                steps.push_back(Step{string(selector.substr(position, end - position)), child});
+                child = false;
+                position = end;
+            }
+        }
+        return steps;
+    }
+
+    bool matchAncestors(const vector<Step>& steps, size_t step, uint32_t index) const {
+        if (step == 0) {
+            return true;
+        }
+
+        auto wanted = nameIds.find(steps[step - 1].name);
+        if (wanted == nameIds.end()) {
+            return false;
+        }
+
+        for (auto ancestor = nodes[index].logicalParent; ancestor != none;
+             ancestor = nodes[ancestor].logicalParent) {
+            if (nodes[ancestor].name == wanted->second && matchAncestors(steps, step - 1, ancestor)) {
+                return true;
+            }
+            if (steps[step].child) {
+                return false;
+            }
+        }
+        return false;
+    }
+
+    vector<FlatNode> nodes;
+    vector<string> names;
+    unordered_map<string, uint32_t> nameIds;
+    vector<vector<uint32_t>> postings;
+    uint32_t itemName;
+};
+
+struct IndexedParse {
+    Result result;
+    AstIndex index;
+};
+
+IndexedParse parseIndexed(const Parser& parser, string_view source) {
+    auto result = parser(source);
+    AstIndex index(result.results);
+    return IndexedParse{std::move(result), std::move(index)};
+}
@@ -0,0 +1,113 @@
+// Replays captured slow parses.
+//
+//     replay <bundle> [--counters] [--trace <file>]
+//     replay --capture <input> [threshold-us] [directory]
+//
+// The first form checks the bundle's grammar fingerprint against the grammar
+// this tool was built with, applies the captured AST shape and predictive
+// mode, warns about captured settings it cannot apply - the JIT, the
+// compiler and optimisation - when they differ from its own, then reruns the
+// parse under the rule profiler and, with --trace, the rule tracer. The second form parses a file through
+// SlowParseCapture, which writes a bundle when the parse is slow.
+
+#include "grammar.h"
+#include "profiler.h"
+#include "replay.h"
+#include "tracer.h"
+
+int capture(int argc, char** argv) {
+    ifstream file(argv[2], ios::binary);
+    if (!file) {
+        cerr << "Cannot open " << argv[2] << "\n";
+        return 1;
+    }
+    stringstream content;
+    content << file.rdbuf();
+
+    auto threshold = chrono::microseconds(argc > 3 ? stoul(argv[3]) : 1000);
+    filesystem::path directory = argc > 4 ? argv[4] : "slow-parses";
+
+    SlowParseCapture capture(parse, threshold, directory);
+    capture.parse(content.str());
+
+    if (capture.lastCapture().empty()) {
+        cout << "Nothing captured: the parse was faster than the threshold or the bundle could not be written\n";
+    } else {
+        cout << "Captured " << capture.lastCapture().string() << "\n";
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 2 && string(argv[1]) == "--capture") {
+        return capture(argc, argv);
+    }
+    if (argc < 2) {
+        cerr << "Usage: replay <bundle> [--counters] [--trace <file>]\n"
+             << "       replay --capture <input> [threshold-us] [directory]\n";
+        return 2;
+    }
+
+    bool countHardwareEvents = false;
+    string tracePath;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--counters") {
+            countHardwareEvents = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+    }
+
+    ReplayBundle bundle;
+    if (!readReplayBundle(argv[1], bundle)) {
+        cerr << "Cannot read replay bundle " << argv[1] << "\n";
+        return 1;
+    }
+
+    cout << "Input: " << bundle.input.size() << " bytes\n";
+    cout << "Captured: " << bundle.elapsedNanoseconds / 1000.0 << " us, " << bundle.steps << " steps\n";
+    for (auto& entry : bundle.configuration) {
+        cout << "  " << entry.first << " = " << entry.second << "\n";
+    }
+
+    if (bundle.grammarFingerprint != grammarFingerprint(parse)) {
+        cout << "Warning: the bundle was captured with a different grammar, the replay may not reproduce it\n";
+    }
+    for (auto& key : applyConfiguration(bundle.configuration)) {
+        cout << "Warning: captured with " << key << " = " << configurationValue(bundle.configuration, key)
+             << " but replaying with " << configurationValue(engineConfiguration(), key);
+        if (key == "jit") {
+            cout << "; rerun with PARSER_JIT set to match";
+        }
+        cout << "\n";
+    }
+
+    RuleProfiler profiler(countHardwareEvents);
+    ofstream traceFile;
+    unique_ptr<RuleTracer> tracer;
+    vector<RuleObserver*> observers = {&profiler};
+    if (!tracePath.empty()) {
+        traceFile.open(tracePath);
+        tracer = make_unique<RuleTracer>(traceFile, bundle.input);
+        observers.push_back(tracer.get());
+    }
+    RuleObservers all(observers);
+
+    // One untraced run for comparable timing, then one under the observers.
+    combinatorSteps = 0;
+    auto start = chrono::steady_clock::now();
+    parse(bundle.input);
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+    cout << "Replayed: " << elapsed.count() / 1000.0 << " us, " << combinatorSteps << " steps\n\n";
+
+    ruleObserver = &all;
+    auto result = parse(bundle.input);
+    ruleObserver = nullptr;
+
+    cout << "Result: " << (result.isSuccess() ? "Success" : "Failure") << "\n\n";
+    profiler.report(cout);
+    if (!tracePath.empty()) {
+        cout << "\nTrace written to " << tracePath << "\n";
+    }
+}
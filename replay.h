@@ -0,0 +1,302 @@
+#pragma once
+
+// Capture of slow parses for offline replay.
+//
+// SlowParseCapture times every parse it runs. When one takes longer than the
+// threshold it writes a replay bundle - the input, a fingerprint of the
+// grammar, the engine configuration and the observed cost - to a directory
+// on local disk. The replay tool loads such a bundle and reruns the exact
+// parse under the profiler and the tracer.
+//
+// Bundles are a small binary format: the magic "PRB1", then varint-prefixed
+// fields in the order of ReplayBundle.
+
+#include "predictive.h"
+#include "sample.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+struct ReplayBundle {
+    string input;
+    uint64_t grammarFingerprint = 0;
+    vector<pair<string, string>> configuration;
+    uint64_t elapsedNanoseconds = 0;
+    uint64_t steps = 0;
+};
+
+// Parsers are opaque closures, so a grammar is identified by what it does:
+// the status, the length matched and the result trees it produces on a fixed
+// set of probe inputs. Any change to the grammar that affects parsing
+// changes it. The probes run in the default AstShape with predictive parsing
+// on, and step counts and error messages are left out, as they differ with
+// the JIT and the engine settings rather than with the grammar.
+uint64_t grammarFingerprint(const Parser& parser) {
+    const string probes[] = {
+        sampleSource,
+        "",
+        "struct { }",
+        "function f (int a,) { if a + (b { } }",
+        "const x = 1 const y = x"
+    };
+
+    auto savedObserver = ruleObserver;
+    auto savedSteps = combinatorSteps;
+    auto savedShape = astShape;
+    auto savedPredictive = predictiveParsing;
+    auto savedHashes = subtreeHashes;
+    ruleObserver = nullptr;
+    astShape = AstShape{};
+    predictiveParsing = true;
+    subtreeHashes = true;
+
+    uint64_t hash = fnv1a("grammar");
+    for (auto& probe : probes) {
+        auto result = parser(probe);
+        stringstream summary;
+        summary << int(result.status) << " " << result.matched.size();
+        for (auto& item : result.results) {
+            summary << " " << item.hash;
+        }
+        hash = fnv1a(summary.str(), hash);
+    }
+
+    ruleObserver = savedObserver;
+    combinatorSteps = savedSteps;
+    astShape = savedShape;
+    predictiveParsing = savedPredictive;
+    subtreeHashes = savedHashes;
+    return hash;
+}
+
+// Everything about how the engine was built and run that can change the cost
+// of a parse without changing the grammar.
+vector<pair<string, string>> engineConfiguration() {
+    vector<pair<string, string>> configuration;
+    configuration.push_back({"compiler", __VERSION__});
+#ifdef __OPTIMIZE__
+    configuration.push_back({"optimized", "yes"});
+#else
+    configuration.push_back({"optimized", "no"});
+#endif
+    configuration.push_back({"rule-observer", ruleObserver ? "installed" : "none"});
+    configuration.push_back({"elide-wrappers", astShape.elideWrappers ? "yes" : "no"});
+    configuration.push_back({"flatten-items", astShape.flattenItems ? "yes" : "no"});
+    configuration.push_back({"jit", RuleJit::supported() && RuleJit::enabledByEnvironment() ? "enabled" : "disabled"});
+    configuration.push_back({"predictive", predictiveParsing ? "yes" : "no"});
+    return configuration;
+}
+
+// The value of `key` in a captured configuration, or empty.
+string configurationValue(const vector<pair<string, string>>& configuration, const string& key) {
+    for (auto& entry : configuration) {
+        if (entry.first == key) {
+            return entry.second;
+        }
+    }
+    return "";
+}
+
+// Sets the AST shape and predictive mode of the calling thread to those in a
+// captured configuration. The JIT and the build cannot be changed at run
+// time; returns the keys that differ from how this process runs.
+vector<string> applyConfiguration(const vector<pair<string, string>>& configuration) {
+    auto flag = [&](const string& key, bool current) {
+        auto value = configurationValue(configuration, key);
+        return value.empty() ? current : value == "yes";
+    };
+    astShape.elideWrappers = flag("elide-wrappers", astShape.elideWrappers);
+    astShape.flattenItems = flag("flatten-items", astShape.flattenItems);
+    predictiveParsing = flag("predictive", predictiveParsing);
+
+    vector<string> differing;
+    auto current = engineConfiguration();
+    for (auto key : {"compiler", "optimized", "jit"}) {
+        auto captured = configurationValue(configuration, key);
+        if (!captured.empty() && captured != configurationValue(current, key)) {
+            differing.push_back(key);
+        }
+    }
+    return differing;
+}
+
+namespace replay_format {
+
+void writeVarint(ostream& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.put(char(value | 0x80));
+        value >>= 7;
+    }
+    out.put(char(value));
+}
+
+void writeString(ostream& out, string_view value) {
+    writeVarint(out, value.size());
+    out.write(value.data(), value.size());
+}
+
+bool readVarint(istream& in, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        auto ch = in.get();
+        if (ch == EOF) {
+            return false;
+        }
+        value |= uint64_t(ch & 0x7f) << shift;
+        if ((ch & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytes left in `in`, or UINT64_MAX when it cannot tell.
+uint64_t remaining(istream& in) {
+    auto position = in.tellg();
+    if (position == istream::pos_type(-1) || !in.seekg(0, ios::end)) {
+        in.clear();
+        return UINT64_MAX;
+    }
+    auto end = in.tellg();
+    in.seekg(position);
+    return uint64_t(end - position);
+}
+
+// Sizes come from the file, so a corrupt one must not decide how much is
+// allocated: the size is checked against what is left to read, and strings
+// grow a chunk at a time as their bytes arrive.
+bool readString(istream& in, string& value) {
+    uint64_t size;
+    if (!readVarint(in, size) || size > remaining(in)) {
+        return false;
+    }
+    value.clear();
+    while (value.size() < size) {
+        auto start = value.size();
+        auto chunk = min<uint64_t>(size - start, 64 * 1024);
+        value.resize(start + chunk);
+        if (!in.read(&value[start], chunk)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char magic[] = "PRB1";
+
+}
+
+bool writeReplayBundle(const filesystem::path& path, const ReplayBundle& bundle) {
+    using namespace replay_format;
+
+    ofstream out(path, ios::binary);
+    out.write(magic, 4);
+    writeString(out, bundle.input);
+    writeVarint(out, bundle.grammarFingerprint);
+    writeVarint(out, bundle.configuration.size());
+    for (auto& entry : bundle.configuration) {
+        writeString(out, entry.first);
+        writeString(out, entry.second);
+    }
+    writeVarint(out, bundle.elapsedNanoseconds);
+    writeVarint(out, bundle.steps);
+    out.close();
+    return bool(out);
+}
+
+bool readReplayBundle(const filesystem::path& path, ReplayBundle& bundle) {
+    using namespace replay_format;
+
+    ifstream in(path, ios::binary);
+    char header[4];
+    if (!in.read(header, 4) || string_view(header, 4) != string_view(magic, 4)) {
+        return false;
+    }
+
+    uint64_t entries;
+    if (!readString(in, bundle.input) ||
+        !readVarint(in, bundle.grammarFingerprint) ||
+        !readVarint(in, entries)) {
+        return false;
+    }
+
+    bundle.configuration.clear();
+    for (uint64_t i = 0; i < entries; i++) {
+        pair<string, string> entry;
+        if (!readString(in, entry.first) || !readString(in, entry.second)) {
+            return false;
+        }
+        bundle.configuration.push_back(entry);
+    }
+
+    return readVarint(in, bundle.elapsedNanoseconds) && readVarint(in, bundle.steps);
+}
+
+class SlowParseCapture {
+public:
+    SlowParseCapture(Parser parser, chrono::nanoseconds threshold, filesystem::path directory):
+        parser(parser),
+        threshold(threshold),
+        directory(directory),
+        fingerprint(grammarFingerprint(parser)) {
+    }
+
+    Result parse(string_view source) {
+        auto savedSteps = combinatorSteps;
+        combinatorSteps = 0;
+
+        auto start = chrono::steady_clock::now();
+        auto result = parser(source);
+        auto elapsed = chrono::steady_clock::now() - start;
+
+        auto steps = combinatorSteps;
+        combinatorSteps = savedSteps + steps;
+
+        if (elapsed > threshold) {
+            capture(source, elapsed, steps);
+        }
+        return result;
+    }
+
+    // Path of the most recent bundle written, empty when nothing was slow.
+    const filesystem::path& lastCapture() const { return last; }
+
+private:
+    void capture(string_view source, chrono::nanoseconds elapsed, uint64_t steps) {
+        ReplayBundle bundle;
+        bundle.input = string(source);
+        bundle.grammarFingerprint = fingerprint;
+        bundle.configuration = engineConfiguration();
+        bundle.configuration.push_back({"threshold-ns", to_string(threshold.count())});
+        bundle.elapsedNanoseconds = elapsed.count();
+        bundle.steps = steps;
+
+        auto millis = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+        stringstream name;
+        name << "slow-" << millis << "-" << hex << fnv1a(source) << ".replay";
+
+        // Capturing must never make the parse fail: when the directory or
+        // the file cannot be written the bundle is dropped. Streams do not
+        // throw here, and the filesystem calls report through `error`.
+        error_code error;
+        filesystem::create_directories(directory, error);
+        if (error) {
+            return;
+        }
+        auto path = directory / name.str();
+        if (writeReplayBundle(path, bundle)) {
+            last = path;
+        } else {
+            filesystem::remove(path, error);
+        }
+    }
+
+    Parser parser;
+    chrono::nanoseconds threshold;
+    filesystem::path directory;
+    uint64_t fingerprint;
+    filesystem::path last;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+// The example program parsed by main.cpp and used as default input by the
+// benchmarks and tools.
+
+#include <string>
+
+using namespace std;
+
+const string sampleSource = R""(
+
+        const x = 100
+        const y = 200
+
+        struct Point {
+            int x;
+            int y;
+        }
+
+        struct Line {
+            Point a;
+            Point b;
+
+            function toString() { }
+            function interesect(Line other) { }
+        }
+
+        struct Triangle {
+            Point a;
+            Point b;
+            Point c;
+        }
+
+        function main (int a, int b, int c) {
+            if a * b * c * d + 5*5 == 1000 * 20 {
+
+            }
+        }
+    )"";
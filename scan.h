@@ -0,0 +1,155 @@
+#pragma once
+
+// Combinators that skip ahead to a delimiter.
+//
+// Written with the basic combinators, skipping to a delimiter is
+// many(sequence({notFollowedBy(delimiter), anyChar()})), which runs several
+// std::function calls and builds a Result per byte. takeUntil() and skipTo()
+// find the delimiter with memchr - vectorised in the C library - or, for a
+// set of up to 16 characters, with SSE2 compares over 16 bytes at a time,
+// and return the skipped span as a view. They suit comments, block bodies
+// that are not parsed, and skipping to a synchronisation point after an
+// error.
+//
+// When the delimiter is missing they fail and set sawEndOfInput, since
+// more input might contain it.
+
+#include "parser.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Any one character.
+Parser anyChar() {
+    return [](string_view source) -> Result {
+        combinatorSteps++;
+        if (source.empty()) {
+            sawEndOfInput = true;
+            return Result::failure("End of imput stream.");
+        }
+        return Result::success(source.substr(0, 1), source.substr(1));
+    };
+}
+
+// Succeeds without consuming anything when `parser` fails here.
+Parser notFollowedBy(Parser parser) {
+    return [parser](string_view source) -> Result {
+        combinatorSteps++;
+        // A lookahead: whatever `parser` matches is not kept either way.
+        auto observer = ruleObserver;
+        if (observer != nullptr) {
+            observer->beginAttempt();
+        }
+        auto matched = parser(source).isSuccess();
+        if (observer != nullptr) {
+            observer->endAttempt(true);
+        }
+        if (matched) {
+            return Result::failure("Unexpected input");
+        }
+        return Result::success(source.substr(0, 0), source);
+    };
+}
+
+namespace scan {
+
+// Offset of the first occurrence of `literal` in `source`, or npos.
+size_t findLiteral(string_view source, string_view literal) {
+    if (literal.empty()) {
+        return 0;
+    }
+    auto data = source.data();
+    auto end = data + source.size();
+    auto last = end - min(source.size(), literal.size() - 1);
+
+    for (auto position = data; position < last;) {
+        auto found = static_cast<const char*>(memchr(position, literal[0], last - position));
+        if (found == nullptr) {
+            break;
+        }
+        if (memcmp(found + 1, literal.data() + 1, literal.size() - 1) == 0) {
+            return found - data;
+        }
+        position = found + 1;
+    }
+    return string_view::npos;
+}
+
+// Offset of the first character of `source` in `chars`, or npos.
+size_t findAny(string_view source, string_view chars) {
+    if (chars.size() == 1) {
+        auto found = static_cast<const char*>(memchr(source.data(), chars[0], source.size()));
+        return found == nullptr ? string_view::npos : found - source.data();
+    }
+
+    size_t position = 0;
+#ifdef __SSE2__
+    if (chars.size() <= 16) {
+        __m128i wanted[16];
+        for (size_t i = 0; i < chars.size(); i++) {
+            wanted[i] = _mm_set1_epi8(chars[i]);
+        }
+        for (; position + 16 <= source.size(); position += 16) {
+            auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source.data() + position));
+            auto hits = _mm_setzero_si128();
+            for (size_t i = 0; i < chars.size(); i++) {
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, wanted[i]));
+            }
+            if (auto mask = _mm_movemask_epi8(hits)) {
+                return position + __builtin_ctz(mask);
+            }
+        }
+    }
+#endif
+    return source.find_first_of(chars, position);
+}
+
+Result take(string_view source, size_t length, size_t delimiter, const string& error) {
+    if (length == string_view::npos) {
+        sawEndOfInput = true;
+        return Result::failure(error);
+    }
+    length += delimiter;
+    return Result::success(source.substr(0, length), source.substr(length));
+}
+
+}
+
+// Everything up to, not including, the first occurrence of `literal`.
+Parser takeUntil(string literal) {
+    auto error = "Expected \"" + literal + "\"";
+    return [literal, error](string_view source) -> Result {
+        combinatorSteps++;
+        return scan::take(source, scan::findLiteral(source, literal), 0, error);
+    };
+}
+
+// Everything up to, not including, the first character in `chars`.
+Parser takeUntilAny(string chars) {
+    auto error = "Expected one of \"" + chars + "\"";
+    return [chars, error](string_view source) -> Result {
+        combinatorSteps++;
+        return scan::take(source, scan::findAny(source, chars), 0, error);
+    };
+}
+
+// Everything up to and including the first occurrence of `literal`.
+Parser skipTo(string literal) {
+    auto error = "Expected \"" + literal + "\"";
+    return [literal, error](string_view source) -> Result {
+        combinatorSteps++;
+        return scan::take(source, scan::findLiteral(source, literal), literal.size(), error);
+    };
+}
+
+// Everything up to and including the first character in `chars`.
+Parser skipToAny(string chars) {
+    auto error = "Expected one of \"" + chars + "\"";
+    return [chars, error](string_view source) -> Result {
+        combinatorSteps++;
+        return scan::take(source, scan::findAny(source, chars), 1, error);
+    };
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+// Zero-copy publishing of parse results through shared memory.
+//
+// publishSharedAst() lays a parse result out in a memfd: a header, a flat
+// array of nodes that refer to each other and to their text by offsets, and
+// the text itself. Nothing in it is a pointer, so any process can map the
+// file anywhere and read the tree in place through SharedAstView, with no
+// copy and no deserialisation. The result is written from a finished
+// ResultMap: combinators build results as values, so there is no arena to
+// build them into while parsing, and publishing costs one copy of the tree.
+// The sizes are computed in a first pass so the nodes are written straight
+// into the final mapping, and the memfd is sealed afterwards so readers can
+// rely on it never changing. Offsets are 32 bits, so results whose layout
+// exceeds 4 GB are not published.
+//
+// Readers map only sealed files, and check every offset and link against
+// the mapping before use, so a corrupt file is rejected rather than read
+// out of bounds.
+//
+// Other processes get the descriptor by inheriting it, over a unix socket,
+// or by opening /proc/<pid>/fd/<fd> of the publisher.
+
+#include "parser.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct SharedAstHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t nodeCount;
+    uint32_t nodesOffset;
+    uint32_t textOffset;
+    uint32_t textSize;
+    uint64_t totalSize;
+};
+
+struct SharedAstNode {
+    uint32_t nameOffset;
+    uint32_t nameLength;
+    uint32_t valueOffset;
+    uint32_t valueLength;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint32_t parent;
+    uint32_t isLeaf;
+};
+
+const uint32_t sharedAstNone = UINT32_MAX;
+
+class SharedAstView {
+public:
+    SharedAstView() {}
+
+    // Maps `fd` read-only. The descriptor may be closed afterwards.
+    explicit SharedAstView(int fd) {
+        struct stat info;
+        if (fstat(fd, &info) != 0 || size_t(info.st_size) < sizeof(SharedAstHeader)) {
+            return;
+        }
+
+        auto address = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED) {
+            return;
+        }
+
+        base = static_cast<const char*>(address);
+        length = info.st_size;
+        auto required = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+        auto seals = fcntl(fd, F_GET_SEALS);
+        if (seals < 0 || (seals & required) != required || !wellFormed()) {
+            munmap(address, length);
+            base = nullptr;
+            length = 0;
+        }
+    }
+
+    // Maps the descriptor `fd` of process `pid`.
+    static SharedAstView open(pid_t pid, int fd) {
+        auto path = "/proc/" + to_string(pid) + "/fd/" + to_string(fd);
+        int own = ::open(path.c_str(), O_RDONLY);
+        if (own < 0) {
+            return SharedAstView();
+        }
+        SharedAstView view(own);
+        close(own);
+        return view;
+    }
+
+    SharedAstView(const SharedAstView&) = delete;
+    SharedAstView& operator=(const SharedAstView&) = delete;
+
+    SharedAstView(SharedAstView&& other): base(other.base), length(other.length) {
+        other.base = nullptr;
+        other.length = 0;
+    }
+
+    ~SharedAstView() {
+        if (base != nullptr) {
+            munmap(const_cast<char*>(base), length);
+        }
+    }
+
+    bool valid() const { return base != nullptr; }
+    uint32_t size() const { return header().nodeCount; }
+
+    // Top-level items are the children of node 0, a nameless root.
+    uint32_t root() const { return 0; }
+
+    const SharedAstNode& node(uint32_t index) const {
+        return reinterpret_cast<const SharedAstNode*>(base + header().nodesOffset)[index];
+    }
+
+    string_view name(uint32_t index) const {
+        auto& n = node(index);
+        return string_view(base + header().textOffset + n.nameOffset, n.nameLength);
+    }
+
+    string_view value(uint32_t index) const {
+        auto& n = node(index);
+        return string_view(base + header().textOffset + n.valueOffset, n.valueLength);
+    }
+
+private:
+    const SharedAstHeader& header() const { return *reinterpret_cast<const SharedAstHeader*>(base); }
+
+    // Whether the header, every node's text and every link lie within the
+    // mapping. Links other than parent point forward, as the publisher
+    // writes nodes in preorder, so walking them always ends.
+    bool wellFormed() const {
+        auto& h = header();
+        if (memcmp(h.magic, "PAST", 4) != 0 || h.version != 1 || h.totalSize != length || h.nodeCount == 0 ||
+            h.nodesOffset < sizeof(SharedAstHeader) || h.nodesOffset % alignof(SharedAstNode) != 0 ||
+            uint64_t(h.nodesOffset) + uint64_t(h.nodeCount) * sizeof(SharedAstNode) > h.textOffset ||
+            uint64_t(h.textOffset) + h.textSize != length) {
+            return false;
+        }
+        auto inText = [&](uint32_t offset, uint32_t size) { return uint64_t(offset) + size <= h.textSize; };
+        auto forward = [&](uint32_t link, uint32_t index) {
+            return link == sharedAstNone || (link > index && link < h.nodeCount);
+        };
+        for (uint32_t index = 0; index < h.nodeCount; index++) {
+            auto& n = node(index);
+            auto parentValid = index == 0 ? n.parent == sharedAstNone : n.parent < index;
+            if (!inText(n.nameOffset, n.nameLength) || !inText(n.valueOffset, n.valueLength) ||
+                !forward(n.firstChild, index) || !forward(n.nextSibling, index) || !parentValid) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const char* base = nullptr;
+    size_t length = 0;
+};
+
+namespace shared_ast {
+
+// The text area holds each distinct name once, followed by all leaf values
+// in document order.
+struct Layout {
+    uint64_t nodes = 1;
+    uint64_t nameBytes = 0;
+    uint64_t valueBytes = 0;
+    unordered_map<string, uint64_t> names;
+};
+
+void measure(const ResultMap& items, Layout& layout) {
+    for (auto& item : items) {
+        layout.nodes++;
+        if (layout.names.emplace(item.name, layout.nameBytes).second) {
+            layout.nameBytes += item.name.size();
+        }
+        if (item.value.index() == 0) {
+            layout.valueBytes += std::get<0>(item.value).size();
+        } else {
+            measure(std::get<1>(item.value), layout);
+        }
+    }
+}
+
+struct Writer {
+    SharedAstNode* nodes;
+    char* text;
+    const Layout& layout;
+    uint32_t nextNode = 1;
+    uint32_t nextText;
+
+    void write(const ResultMap& items, uint32_t parent) {
+        auto previous = sharedAstNone;
+        for (auto& item : items) {
+            auto index = nextNode++;
+            auto& node = nodes[index];
+            node = SharedAstNode{uint32_t(layout.names.at(item.name)), uint32_t(item.name.size()), 0, 0,
+                                 sharedAstNone, sharedAstNone, parent, item.value.index() == 0};
+
+            if (previous == sharedAstNone) {
+                nodes[parent].firstChild = index;
+            } else {
+                nodes[previous].nextSibling = index;
+            }
+            previous = index;
+
+            if (item.value.index() == 0) {
+                auto& value = std::get<0>(item.value);
+                node.valueOffset = nextText;
+                node.valueLength = uint32_t(value.size());
+                memcpy(text + nextText, value.data(), value.size());
+                nextText += uint32_t(value.size());
+            } else {
+                write(std::get<1>(item.value), index);
+            }
+        }
+    }
+};
+
+}
+
+// Writes `results` into a new sealed memfd and returns its descriptor, or
+// -1 on failure, including a layout too large for 32-bit offsets. The
+// caller owns the descriptor.
+int publishSharedAst(const ResultMap& results, const char* name = "parse-ast") {
+    using namespace shared_ast;
+
+    Layout layout;
+    measure(results, layout);
+
+    uint64_t nodesOffset = (sizeof(SharedAstHeader) + 7) / 8 * 8;
+    uint64_t textOffset = nodesOffset + layout.nodes * sizeof(SharedAstNode);
+    uint64_t textSize = layout.nameBytes + layout.valueBytes;
+    uint64_t totalSize = textOffset + textSize;
+    if (textOffset > UINT32_MAX || textSize > UINT32_MAX) {
+        return -1;
+    }
+
+    int fd = memfd_create(name, MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, totalSize) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    auto address = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+
+    auto base = static_cast<char*>(address);
+    auto& header = *reinterpret_cast<SharedAstHeader*>(base);
+    header = SharedAstHeader{{'P', 'A', 'S', 'T'}, 1, uint32_t(layout.nodes), uint32_t(nodesOffset),
+                             uint32_t(textOffset), uint32_t(textSize), totalSize};
+
+    auto text = base + textOffset;
+    for (auto& entry : layout.names) {
+        memcpy(text + entry.second, entry.first.data(), entry.first.size());
+    }
+
+    auto nodes = reinterpret_cast<SharedAstNode*>(base + nodesOffset);
+    nodes[0] = SharedAstNode{0, 0, 0, 0, sharedAstNone, sharedAstNone, sharedAstNone, 0};
+
+    Writer writer{nodes, text, layout, 1, uint32_t(layout.nameBytes)};
+    writer.write(results, 0);
+
+    munmap(address, totalSize);
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+// Declaration sidecar index for random access into large files.
+//
+// The first parse of a file records, for every top-level declaration, its
+// kind, a hash of its name and the byte range it occupies. The index is
+// small and fixed-size per entry, so it can be saved next to the source and
+// loaded later to parse "the 50,000th function" or "the struct named X" by
+// running the `declaration` rule on just that range instead of parsing the
+// file from the start.
+//
+// Sidecar files are the magic "PDX1", the source size and hash, the entry
+// count and then the entries as they are laid out in memory.
+
+#include "grammar.h"
+
+#include <fstream>
+
+enum class DeclarationKind : uint8_t {
+    Other = 0,
+    Struct = 1,
+    Const = 2,
+    Function = 3
+};
+
+struct DeclarationEntry {
+    uint64_t nameHash;
+    uint64_t offset;
+    uint32_t length;
+    DeclarationKind kind;
+    // Spelled out so saved entries contain no uninitialised bytes.
+    uint8_t padding[3];
+};
+
+DeclarationKind declarationKind(const string& rule) {
+    if (rule == "struct") {
+        return DeclarationKind::Struct;
+    }
+    if (rule == "const") {
+        return DeclarationKind::Const;
+    }
+    if (rule == "function") {
+        return DeclarationKind::Function;
+    }
+    return DeclarationKind::Other;
+}
+
+class DeclarationIndex {
+public:
+    DeclarationIndex() {}
+
+    DeclarationIndex(string_view source, vector<DeclarationEntry> entries):
+        sourceSize(source.size()),
+        sourceHash(fnv1a(source)),
+        declarations(std::move(entries)) {
+    }
+
+    size_t size() const { return declarations.size(); }
+    const DeclarationEntry& operator[](size_t index) const { return declarations[index]; }
+
+    // Whether this index was built from exactly `source`.
+    bool describes(string_view source) const {
+        return source.size() == sourceSize && fnv1a(source) == sourceHash;
+    }
+
+    // The n-th declaration of a kind, counting from zero, or nullptr.
+    const DeclarationEntry* nth(DeclarationKind kind, size_t n) const {
+        for (auto& entry : declarations) {
+            if (entry.kind == kind && n-- == 0) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    // Declarations whose name hashes like `name`. Hashes can collide, so
+    // callers confirm the name on the parsed declaration.
+    vector<const DeclarationEntry*> named(string_view name) const {
+        vector<const DeclarationEntry*> result;
+        auto hash = fnv1a(name);
+        for (auto& entry : declarations) {
+            if (entry.nameHash == hash) {
+                result.push_back(&entry);
+            }
+        }
+        return result;
+    }
+
+    bool save(const string& path) const {
+        ofstream out(path, ios::binary);
+        uint64_t count = declarations.size();
+        out.write("PDX1", 4);
+        out.write(reinterpret_cast<const char*>(&sourceSize), sizeof(sourceSize));
+        out.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+        out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        out.write(reinterpret_cast<const char*>(declarations.data()), count * sizeof(DeclarationEntry));
+        return bool(out);
+    }
+
+    bool load(const string& path) {
+        ifstream in(path, ios::binary);
+        char magic[4];
+        uint64_t count;
+        if (!in.read(magic, 4) || string_view(magic, 4) != "PDX1" ||
+            !in.read(reinterpret_cast<char*>(&sourceSize), sizeof(sourceSize)) ||
+            !in.read(reinterpret_cast<char*>(&sourceHash), sizeof(sourceHash)) ||
+            !in.read(reinterpret_cast<char*>(&count), sizeof(count))) {
+            return false;
+        }
+        // The count comes from the file, so it is checked against what the
+        // file holds before anything is allocated for it.
+        auto start = in.tellg();
+        in.seekg(0, ios::end);
+        auto end = in.tellg();
+        in.seekg(start);
+        if (start < 0 || end < start || count > uint64_t(end - start) / sizeof(DeclarationEntry)) {
+            return false;
+        }
+        declarations.resize(count);
+        return bool(in.read(reinterpret_cast<char*>(declarations.data()), count * sizeof(DeclarationEntry)));
+    }
+
+private:
+    uint64_t sourceSize = 0;
+    uint64_t sourceHash = 0;
+    vector<DeclarationEntry> declarations;
+};
+
+// Records every named rule that matched directly below the outermost rule
+// of a parse - for `parse`, the declarations under "ast".
+class DeclarationRecorder : public RuleObserver {
+public:
+    explicit DeclarationRecorder(string_view input): input(input) {}
+
+    void enter(const string&, string_view) override {
+        depth++;
+    }
+
+    void exit(const string& rule, const Result& result) override {
+        depth--;
+        if (depth != 1 || result.isFailure()) {
+            return;
+        }
+
+        // Declarations start with optional white space; the entry covers
+        // the declaration itself.
+        auto matched = result.matched;
+        auto skip = min(matched.find_first_not_of(" \t\r\n"), matched.size());
+        matched.remove_prefix(skip);
+
+        string name;
+        if (!result.results.empty() && result.results.back().value.index() == 1) {
+            for (auto& item : std::get<1>(result.results.back().value)) {
+                if (item.name == "name" && item.value.index() == 0) {
+                    name = std::get<0>(item.value);
+                    break;
+                }
+            }
+        }
+
+        entries.push_back(DeclarationEntry{
+            fnv1a(name),
+            uint64_t(matched.data() - input.data()),
+            uint32_t(matched.size()),
+            declarationKind(rule),
+            {}
+        });
+    }
+
+    vector<DeclarationEntry> entries;
+
+private:
+    string_view input;
+    int depth = 0;
+};
+
+// Parses `source` with `parse`, building its declaration index on the way.
+Result parseWithSidecar(string_view source, DeclarationIndex& index) {
+    DeclarationRecorder recorder(source);
+
+    auto savedObserver = ruleObserver;
+    ruleObserver = &recorder;
+    auto result = parse(source);
+    ruleObserver = savedObserver;
+
+    index = DeclarationIndex(source, std::move(recorder.entries));
+    return result;
+}
+
+// Parses only the declaration `entry` of `index` describes. Fails if the
+// index was built from another source or the entry lies outside it, as a
+// loaded sidecar may be stale or corrupt. Checking the source hashes all
+// of it, which costs far less than parsing it.
+Result parseDeclaration(string_view source, const DeclarationIndex& index, const DeclarationEntry& entry) {
+    if (!index.describes(source)) {
+        return Result::failure("The declaration index was built from another source.");
+    }
+    if (entry.offset > source.size() || entry.length > source.size() - entry.offset) {
+        return Result::failure("The declaration lies outside the source.");
+    }
+    return declaration(source.substr(entry.offset, entry.length));
+}
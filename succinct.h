@@ -0,0 +1,443 @@
+#pragma once
+
+// Succinct encoding of very large parse results.
+//
+// The shape of the tree is a balanced-parentheses bit vector - a 1 when a
+// node opens and a 0 when it closes, in preorder - so two bits per node.
+// A rank directory gives rank in constant time and select in O(log n).
+// First child is constant time; next sibling, parent and subtree size
+// search for a matching parenthesis through per-word excess summaries and
+// a range-min tree over blocks of words, so they take O(log n).
+//
+// Node names are bit-packed ids into a name table. Results keep no source
+// positions, so instead of span deltas the leaf values themselves are
+// concatenated into one text blob, addressed by bit-packed lengths - the
+// deltas between consecutive value offsets - with an absolute offset
+// sampled every 64 nodes. A node is identified by the position of its
+// opening parenthesis; its preorder number is rank1 of that position.
+
+#include "parser.h"
+
+#include <climits>
+#include <cstdint>
+#include <unordered_map>
+
+// Fixed-width unsigned integers packed back to back into 64-bit words.
+class PackedInts {
+public:
+    PackedInts(): width(1) {}
+    PackedInts(size_t size, unsigned width): words((size * width + 63) / 64 + 1, 0), width(width) {}
+
+    void set(size_t index, uint64_t value) {
+        auto bit = index * width;
+        auto word = bit / 64, offset = bit % 64;
+        words[word] |= value << offset;
+        if (offset + width > 64) {
+            words[word + 1] |= value >> (64 - offset);
+        }
+    }
+
+    uint64_t get(size_t index) const {
+        auto bit = index * width;
+        auto word = bit / 64, offset = bit % 64;
+        auto value = words[word] >> offset;
+        if (offset + width > 64) {
+            value |= words[word + 1] << (64 - offset);
+        }
+        return width == 64 ? value : value & ((uint64_t(1) << width) - 1);
+    }
+
+    size_t sizeInBits() const { return words.size() * 64; }
+
+    static unsigned widthFor(uint64_t maximum) {
+        unsigned width = 1;
+        while (width < 64 && (maximum >> width) != 0) {
+            width++;
+        }
+        return width;
+    }
+
+private:
+    vector<uint64_t> words;
+    unsigned width;
+};
+
+class BalancedParentheses {
+public:
+    static const size_t none = SIZE_MAX;
+
+    void push(bool open) {
+        if (length % 64 == 0) {
+            words.push_back(0);
+        }
+        if (open) {
+            words.back() |= uint64_t(1) << (length % 64);
+        }
+        length++;
+    }
+
+    // Builds the rank directory, excess summaries and range-min tree; call
+    // once after the last push.
+    void finish() {
+        superRanks.assign(words.size() / wordsPerBlock + 1, 0);
+        wordRanks.assign(words.size() + 1, 0);
+        minimumAfter.assign(words.size(), 0);
+        minimumBefore.assign(words.size(), 0);
+
+        uint64_t rank = 0;
+        for (size_t word = 0; word < words.size(); word++) {
+            if (word % wordsPerBlock == 0) {
+                superRanks[word / wordsPerBlock] = rank;
+            }
+            wordRanks[word] = uint16_t(rank - superRanks[word / wordsPerBlock]);
+            rank += __builtin_popcountll(words[word]);
+
+            int excess = 0, lowestAfter = 1 << 30, lowestBefore = 0;
+            for (size_t bit = 0; bit < 64 && word * 64 + bit < length; bit++) {
+                excess += (words[word] >> bit) & 1 ? 1 : -1;
+                lowestAfter = min(lowestAfter, excess);
+                if (bit < 63) {
+                    lowestBefore = min(lowestBefore, excess);
+                }
+            }
+            minimumAfter[word] = int8_t(lowestAfter);
+            minimumBefore[word] = int8_t(lowestBefore);
+        }
+
+        auto last = words.size();
+        if (last % wordsPerBlock == 0) {
+            superRanks[last / wordsPerBlock] = rank;
+        }
+        wordRanks[last] = uint16_t(rank - superRanks[last / wordsPerBlock]);
+
+        auto blocks = (words.size() + wordsPerBlock - 1) / wordsPerBlock;
+        leaves = 1;
+        while (leaves < blocks) {
+            leaves *= 2;
+        }
+        blockMinimumAfter.assign(2 * leaves, INT32_MAX);
+        blockMinimumBefore.assign(2 * leaves, INT32_MAX);
+        for (size_t word = 0; word < words.size(); word++) {
+            auto start = excess(word * 64);
+            auto& after = blockMinimumAfter[leaves + word / wordsPerBlock];
+            auto& before = blockMinimumBefore[leaves + word / wordsPerBlock];
+            after = min(after, int32_t(start + minimumAfter[word]));
+            before = min(before, int32_t(start + minimumBefore[word]));
+        }
+        for (auto node = leaves; node-- > 1;) {
+            blockMinimumAfter[node] = min(blockMinimumAfter[2 * node], blockMinimumAfter[2 * node + 1]);
+            blockMinimumBefore[node] = min(blockMinimumBefore[2 * node], blockMinimumBefore[2 * node + 1]);
+        }
+    }
+
+    size_t size() const { return length; }
+
+    bool operator[](size_t position) const {
+        return (words[position / 64] >> (position % 64)) & 1;
+    }
+
+    // Ones in [0, position).
+    size_t rank1(size_t position) const {
+        auto word = position / 64, bit = position % 64;
+        auto rank = wordRank(word);
+        if (bit != 0) {
+            rank += __builtin_popcountll(words[word] & ((uint64_t(1) << bit) - 1));
+        }
+        return rank;
+    }
+
+    // Position of the one with the given zero-based rank.
+    size_t select1(size_t rank) const {
+        size_t low = 0, high = words.size();
+        while (high - low > 1) {
+            auto middle = (low + high) / 2;
+            if (wordRank(middle) <= rank) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        auto word = words[low];
+        for (auto remaining = rank - wordRank(low); remaining > 0; remaining--) {
+            word &= word - 1;
+        }
+        return low * 64 + __builtin_ctzll(word);
+    }
+
+    // Opens minus closes in [0, position).
+    long excess(size_t position) const {
+        return 2 * long(rank1(position)) - long(position);
+    }
+
+    // The closing parenthesis matching the open one at `position`: the first
+    // point after it where the excess drops back to what it was before it.
+    size_t findClose(size_t position) const {
+        auto target = excess(position);
+        auto current = target + 1;
+
+        auto bit = position + 1;
+        while (bit < length && bit % 64 != 0) {
+            current += (*this)[bit] ? 1 : -1;
+            if (current == target) {
+                return bit;
+            }
+            bit++;
+        }
+
+        auto word = nextWordReaching(bit / 64, target);
+        if (word == none) {
+            return none;
+        }
+        current = excess(word * 64);
+        for (bit = word * 64; bit < length; bit++) {
+            current += (*this)[bit] ? 1 : -1;
+            if (current == target) {
+                return bit;
+            }
+        }
+        return none;
+    }
+
+    // The open parenthesis of the node enclosing the one at `position`: the
+    // last point before it where the excess was one lower.
+    size_t enclose(size_t position) const {
+        auto target = excess(position) - 1;
+        if (target < 0) {
+            return none;
+        }
+
+        auto bit = position;
+        while (bit > 0 && bit % 64 != 0) {
+            bit--;
+            if (excess(bit) == target) {
+                return bit;
+            }
+        }
+
+        auto word = previousWordReaching(bit / 64, target);
+        if (word == none) {
+            return none;
+        }
+        auto current = excess(min(length, (word + 1) * 64));
+        for (bit = min(length, (word + 1) * 64); bit-- > word * 64;) {
+            current -= (*this)[bit] ? 1 : -1;
+            if (current == target) {
+                return bit;
+            }
+        }
+        return none;
+    }
+
+    size_t sizeInBits() const {
+        return words.size() * 64 + superRanks.size() * 64 + wordRanks.size() * 16 +
+               (minimumAfter.size() + minimumBefore.size()) * 8 +
+               (blockMinimumAfter.size() + blockMinimumBefore.size()) * 32;
+    }
+
+private:
+    // Ones before each word: an absolute count every wordsPerBlock words
+    // plus a 16-bit count relative to it for every word.
+    static const size_t wordsPerBlock = 8;
+
+    uint64_t wordRank(size_t word) const {
+        return superRanks[word / wordsPerBlock] + wordRanks[word];
+    }
+
+    // The first word from `word` on in which the excess after some bit
+    // drops to `target` or below.
+    size_t nextWordReaching(size_t word, long target) const {
+        auto reaches = [&](size_t w) { return excess(w * 64) + minimumAfter[w] <= target; };
+        auto end = min(words.size(), (word / wordsPerBlock + 1) * wordsPerBlock);
+        for (; word < end; word++) {
+            if (reaches(word)) {
+                return word;
+            }
+        }
+        if (word >= words.size()) {
+            return none;
+        }
+
+        // Up the tree until a right sibling reaches the target, then down
+        // to its leftmost block that does.
+        auto node = leaves + word / wordsPerBlock;
+        while (blockMinimumAfter[node] > target) {
+            while (node % 2 == 1 && node != 1) {
+                node /= 2;
+            }
+            if (node == 1) {
+                return none;
+            }
+            node++;
+        }
+        while (node < leaves) {
+            node = blockMinimumAfter[2 * node] <= target ? 2 * node : 2 * node + 1;
+        }
+        for (word = (node - leaves) * wordsPerBlock; !reaches(word); word++) {
+        }
+        return word;
+    }
+
+    // The last word before `end` in which the excess before some bit is
+    // `target` or below.
+    size_t previousWordReaching(size_t end, long target) const {
+        auto reaches = [&](size_t w) { return excess(w * 64) + minimumBefore[w] <= target; };
+        if (end == 0) {
+            return none;
+        }
+        auto begin = (end - 1) / wordsPerBlock * wordsPerBlock;
+        for (auto word = end; word-- > begin;) {
+            if (reaches(word)) {
+                return word;
+            }
+        }
+        if (begin == 0) {
+            return none;
+        }
+
+        auto node = leaves + begin / wordsPerBlock - 1;
+        while (blockMinimumBefore[node] > target) {
+            while (node % 2 == 0) {
+                node /= 2;
+            }
+            if (node == 1) {
+                return none;
+            }
+            node--;
+        }
+        while (node < leaves) {
+            node = blockMinimumBefore[2 * node + 1] <= target ? 2 * node + 1 : 2 * node;
+        }
+        auto block = node - leaves;
+        auto word = min(words.size(), (block + 1) * wordsPerBlock);
+        while (!reaches(--word)) {
+        }
+        return word;
+    }
+
+    vector<uint64_t> words;
+    size_t length = 0;
+    vector<uint64_t> superRanks;
+    vector<uint16_t> wordRanks;
+    // Lowest excess relative to the start of each word, over the positions
+    // after each bit and over the positions before each bit.
+    vector<int8_t> minimumAfter;
+    vector<int8_t> minimumBefore;
+    // Range-min tree: the lowest absolute excess in each block of
+    // wordsPerBlock words, over the same positions as above, as a complete
+    // binary tree in an array with the root at 1 and the leaves from
+    // `leaves` on.
+    size_t leaves = 1;
+    vector<int32_t> blockMinimumAfter;
+    vector<int32_t> blockMinimumBefore;
+};
+
+class SuccinctTree {
+public:
+    using Node = size_t;
+    static const Node none = BalancedParentheses::none;
+
+    // Encodes `results` under a nameless root node.
+    explicit SuccinctTree(const ResultMap& results) {
+        vector<uint32_t> nameIds;
+        vector<uint64_t> lengths;
+        unordered_map<string, uint32_t> known;
+
+        auto nameId = [&](const string& name) {
+            auto found = known.find(name);
+            if (found != known.end()) {
+                return found->second;
+            }
+            names.push_back(name);
+            return known[name] = uint32_t(names.size() - 1);
+        };
+
+        std::function<void(const ResultMap&)> encode;
+        encode = [&](const ResultMap& items) {
+            for (auto& item : items) {
+                shape.push(true);
+                nameIds.push_back(nameId(item.name));
+                if (item.value.index() == 0) {
+                    auto& value = std::get<0>(item.value);
+                    lengths.push_back(value.size());
+                    text += value;
+                } else {
+                    lengths.push_back(0);
+                    encode(std::get<1>(item.value));
+                }
+                shape.push(false);
+            }
+        };
+
+        shape.push(true);
+        nameIds.push_back(nameId(""));
+        lengths.push_back(0);
+        encode(results);
+        shape.push(false);
+        shape.finish();
+
+        uint64_t longest = 0;
+        for (auto length : lengths) {
+            longest = max(longest, length);
+        }
+
+        nodeNames = PackedInts(nameIds.size(), PackedInts::widthFor(names.size()));
+        valueLengths = PackedInts(lengths.size(), PackedInts::widthFor(longest));
+        uint64_t offset = 0;
+        for (size_t node = 0; node < nameIds.size(); node++) {
+            if (node % offsetSampling == 0) {
+                offsets.push_back(offset);
+            }
+            nodeNames.set(node, nameIds[node]);
+            valueLengths.set(node, lengths[node]);
+            offset += lengths[node];
+        }
+    }
+
+    Node root() const { return 0; }
+    size_t size() const { return shape.size() / 2; }
+
+    size_t id(Node node) const { return shape.rank1(node); }
+    Node nodeAt(size_t id) const { return shape.select1(id); }
+
+    Node firstChild(Node node) const {
+        return node + 1 < shape.size() && shape[node + 1] ? node + 1 : none;
+    }
+
+    Node nextSibling(Node node) const {
+        auto close = shape.findClose(node);
+        return close + 1 < shape.size() && shape[close + 1] ? close + 1 : none;
+    }
+
+    Node parent(Node node) const { return shape.enclose(node); }
+
+    size_t subtreeSize(Node node) const { return (shape.findClose(node) - node + 1) / 2; }
+
+    bool isLeaf(Node node) const { return firstChild(node) == none; }
+
+    const string& name(Node node) const { return names[nodeNames.get(id(node))]; }
+
+    string_view value(Node node) const {
+        auto index = id(node);
+        auto sample = index / offsetSampling;
+        auto offset = offsets[sample];
+        for (auto i = sample * offsetSampling; i < index; i++) {
+            offset += valueLengths.get(i);
+        }
+        return string_view(text).substr(offset, valueLengths.get(index));
+    }
+
+    // Size of the structure without the name table and value text.
+    size_t sizeInBits() const {
+        return shape.sizeInBits() + nodeNames.sizeInBits() + valueLengths.sizeInBits() + offsets.size() * 64;
+    }
+
+private:
+    static const size_t offsetSampling = 64;
+
+    BalancedParentheses shape;
+    vector<string> names;
+    PackedInts nodeNames;
+    PackedInts valueLengths;
+    vector<uint64_t> offsets;
+    string text;
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+// Rule tracer. Installed as the thread's ruleObserver it writes one line per
+// named rule entered and left, indented by nesting depth, with the byte
+// offset into the traced input and whether the rule matched.
+
+#include "parser.h"
+
+class RuleTracer : public RuleObserver {
+public:
+    RuleTracer(ostream& out, string_view input): out(out), input(input) {}
+
+    void enter(const string& rule, string_view source) override {
+        out << string(depth * 2, ' ') << rule << " @" << offset(source) << "\n";
+        depth++;
+    }
+
+    void exit(const string& rule, const Result& result) override {
+        depth--;
+        out << string(depth * 2, ' ') << "/" << rule;
+        if (result.isSuccess()) {
+            out << " matched " << result.matched.size() << " bytes\n";
+        } else {
+            out << " failed: " << result.error << "\n";
+        }
+    }
+
+private:
+    size_t offset(string_view source) const {
+        return input.size() - source.size();
+    }
+
+    ostream& out;
+    string_view input;
+    size_t depth = 0;
+};
+
+// Forwards rule notifications to several observers, so a parse can be
+// profiled and traced at the same time.
+class RuleObservers : public RuleObserver {
+public:
+    RuleObservers(vector<RuleObserver*> observers): observers(std::move(observers)) {}
+
+    void enter(const string& rule, string_view source) override {
+        for (auto observer : observers) {
+            observer->enter(rule, source);
+        }
+    }
+
+    void exit(const string& rule, const Result& result) override {
+        for (auto observer = observers.rbegin(); observer != observers.rend(); observer++) {
+            (*observer)->exit(rule, result);
+        }
+    }
+
+    void beginAttempt() override {
+        for (auto observer : observers) {
+            observer->beginAttempt();
+        }
+    }
+
+    void endAttempt(bool backtracked) override {
+        for (auto observer = observers.rbegin(); observer != observers.rend(); observer++) {
+            (*observer)->endAttempt(backtracked);
+        }
+    }
+
+private:
+    vector<RuleObserver*> observers;
+};
@@ -0,0 +1,233 @@
+#pragma once
+
+// Cross-reference index of struct types and their uses.
+//
+// For every type name the index lists each field and parameter declared with
+// that type, and for every struct where it is defined. It is built in
+// parallel: files are parsed concurrently, then the top-level declarations
+// of all files are distributed over the same threads, which insert into
+// hash maps split into independently locked shards. Once built the index is
+// read-only and a lookup is one hash into one shard.
+//
+// Files are parsed with the calling thread's AstShape, and declarations are
+// read through unwrapped(), so results with and without "item" wrappers
+// index the same.
+
+#include "parser.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+enum class ReferenceKind {
+    Field,
+    Parameter
+};
+
+struct Reference {
+    ReferenceKind kind;
+    uint32_t file;
+    // Declaration the reference appears in: "Line" or "Line.interesect".
+    string owner;
+    // The field or parameter name.
+    string member;
+};
+
+struct Definition {
+    uint32_t file;
+    // Position of the declaration among the file's top-level declarations.
+    uint32_t declaration;
+};
+
+template <typename Value>
+class ShardedMap {
+public:
+    void add(const string& key, Value value) {
+        auto& shard = shardFor(key);
+        lock_guard<mutex> lock(shard.lock);
+        shard.values[key].push_back(std::move(value));
+    }
+
+    // Only safe once all writers have finished.
+    const vector<Value>& find(const string& key) const {
+        static const vector<Value> empty;
+        auto& shard = shardFor(key);
+        auto found = shard.values.find(key);
+        return found == shard.values.end() ? empty : found->second;
+    }
+
+    vector<string> keys() const {
+        vector<string> result;
+        for (auto& shard : shards) {
+            for (auto& entry : shard.values) {
+                result.push_back(entry.first);
+            }
+        }
+        return result;
+    }
+
+private:
+    static const size_t shardCount = 64;
+
+    struct alignas(64) Shard {
+        mutex lock;
+        unordered_map<string, vector<Value>> values;
+    };
+
+    Shard& shardFor(const string& key) { return shards[std::hash<string>()(key) % shardCount]; }
+    const Shard& shardFor(const string& key) const { return shards[std::hash<string>()(key) % shardCount]; }
+
+    Shard shards[shardCount];
+};
+
+const string* leafValue(const ResultMap& items, const string& name) {
+    for (auto& item : items) {
+        if (item.name == name && item.value.index() == 0) {
+            return &std::get<0>(item.value);
+        }
+    }
+    return nullptr;
+}
+
+const ResultMap* childNode(const ResultMap& items, const string& name) {
+    for (auto& item : items) {
+        if (item.name == name && item.value.index() == 1) {
+            return &std::get<1>(item.value);
+        }
+    }
+    return nullptr;
+}
+
+class CrossReferenceIndex {
+public:
+    // Parses every file with `parser` and indexes the result using up to
+    // `threads` threads.
+    CrossReferenceIndex(const Parser& parser, const vector<string>& files, unsigned threads = 0) {
+        if (threads == 0) {
+            threads = max(1u, thread::hardware_concurrency());
+        }
+
+        auto shape = astShape;
+        vector<Result> results(files.size());
+        runParallel(threads, files.size(), [&](size_t file) {
+            astShape = shape;
+            results[file] = parser(files[file]);
+        });
+
+        vector<pair<uint32_t, const ResultItem*>> declarations;
+        for (size_t file = 0; file < results.size(); file++) {
+            for (auto declaration : topLevelDeclarations(results[file])) {
+                declarations.push_back({uint32_t(file), declaration});
+            }
+        }
+
+        vector<uint32_t> positions(declarations.size());
+        for (size_t i = 1; i < declarations.size(); i++) {
+            positions[i] = declarations[i].first == declarations[i - 1].first ? positions[i - 1] + 1 : 0;
+        }
+
+        runParallel(threads, declarations.size(), [&](size_t i) {
+            indexDeclaration(declarations[i].first, positions[i], *declarations[i].second);
+        });
+    }
+
+    // Uses of `type`, in no particular order since they are added in parallel.
+    const vector<Reference>& referencesTo(const string& type) const { return references.find(type); }
+    const vector<Definition>& definitionsOf(const string& type) const { return definitions.find(type); }
+    vector<string> structNames() const { return definitions.keys(); }
+
+private:
+    template <typename Work>
+    static void runParallel(unsigned threads, size_t count, Work work) {
+        atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (auto i = next++; i < count; i = next++) {
+                work(i);
+            }
+        };
+
+        vector<thread> workers;
+        for (unsigned i = 1; i < threads && i < count; i++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : workers) {
+            thread.join();
+        }
+    }
+
+    // The children of `ast`, each unwrapped from its "item".
+    static vector<const ResultItem*> topLevelDeclarations(const Result& result) {
+        vector<const ResultItem*> declarations;
+        auto ast = childNode(result.results, "ast");
+        if (ast == nullptr) {
+            return declarations;
+        }
+        for (auto& item : *ast) {
+            auto& declaration = unwrapped(item);
+            if (declaration.value.index() == 1) {
+                declarations.push_back(&declaration);
+            }
+        }
+        return declarations;
+    }
+
+    void indexDeclaration(uint32_t file, uint32_t position, const ResultItem& declaration) {
+        if (declaration.value.index() != 1) {
+            return;
+        }
+        auto& body = std::get<1>(declaration.value);
+        if (declaration.name == "struct") {
+            auto name = leafValue(body, "name");
+            if (name == nullptr) {
+                return;
+            }
+            definitions.add(*name, Definition{file, position});
+
+            // A field is an "item" of its type and name, which stays wrapped
+            // in every shape; a method is a function, wrapped or not.
+            for (auto& child : body) {
+                auto& member = unwrapped(child);
+                if (member.value.index() != 1) {
+                    continue;
+                }
+                auto& fields = std::get<1>(member.value);
+                if (member.name == "function") {
+                    indexFunction(file, *name + ".", fields);
+                } else if (member.name == "item") {
+                    auto type = leafValue(fields, "name");
+                    auto field = leafValue(fields, "field");
+                    if (type && field) {
+                        references.add(*type, Reference{ReferenceKind::Field, file, *name, *field});
+                    }
+                }
+            }
+        } else if (declaration.name == "function") {
+            indexFunction(file, "", body);
+        }
+    }
+
+    void indexFunction(uint32_t file, const string& prefix, const ResultMap& function) {
+        auto name = leafValue(function, "name");
+        auto parameters = childNode(function, "parameters");
+        if (name == nullptr || parameters == nullptr) {
+            return;
+        }
+
+        for (auto& item : *parameters) {
+            auto& parameter = unwrapped(item);
+            if (parameter.name != "parameter" || parameter.value.index() != 1) {
+                continue;
+            }
+            auto type = leafValue(std::get<1>(parameter.value), "type");
+            auto member = leafValue(std::get<1>(parameter.value), "name");
+            if (type && member) {
+                references.add(*type, Reference{ReferenceKind::Parameter, file, prefix + *name, *member});
+            }
+        }
+    }
+
+    ShardedMap<Reference> references;
+    ShardedMap<Definition> definitions;
+};